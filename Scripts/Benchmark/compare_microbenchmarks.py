@@ -0,0 +1,46 @@
+#!/usr/bin/env python
+# coding: utf-8
+
+# Compares two results of pandemic-microbenchmark (e.g. before and after a change to geographical_cell) kernel by
+# kernel. A ratio above 1 means the current result is slower; changes of more than the threshold are flagged, and the
+# exit status is 1 if a kernel became slower by more than it or allocates more than before.
+#
+# usage: python compare_microbenchmarks.py BASELINE.csv CURRENT.csv [THRESHOLD (default: 0.10)]
+
+import sys
+import csv
+
+
+def read_results(path):
+    with open(path, newline="") as results:
+        return {(row["kernel"], int(row["neighbors"])): row for row in csv.DictReader(results)}
+
+
+baseline_path, current_path = sys.argv[1:3]
+threshold = float(sys.argv[3]) if len(sys.argv) > 3 else 0.10
+
+baseline = read_results(baseline_path)
+current = read_results(current_path)
+
+regressions = 0
+print("{:<28} {:>9} {:>14} {:>14} {:>7} {:>12}".format("kernel", "neighbors", "baseline ns", "current ns", "ratio",
+                                                       "allocations"))
+for key in sorted(set(baseline) & set(current)):
+    old, new = baseline[key], current[key]
+    ratio = float(new["ns_per_cell_step"]) / float(old["ns_per_cell_step"])
+    old_allocations = float(old["allocations_per_cell_step"])
+    new_allocations = float(new["allocations_per_cell_step"])
+    flag = ""
+    if ratio > 1 + threshold or new_allocations > old_allocations:
+        flag = "  slower" if ratio > 1 + threshold else "  allocates more"
+        regressions += 1
+    elif ratio < 1 - threshold:
+        flag = "  faster"
+    print("{:<28} {:>9} {:>14.1f} {:>14.1f} {:>7.2f} {:>5g} -> {:<5g}{}".format(
+        key[0], key[1], float(old["ns_per_cell_step"]), float(new["ns_per_cell_step"]), ratio, old_allocations,
+        new_allocations, flag))
+
+for key in sorted(set(baseline) ^ set(current)):
+    print("{} with {} neighbors is only in {}".format(key[0], key[1], baseline_path if key in baseline else current_path))
+
+sys.exit(1 if regressions else 0)
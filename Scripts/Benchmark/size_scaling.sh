@@ -0,0 +1,33 @@
+# Measures how the synchronous engine scales with the number of cells, on synthetic scenarios of increasing size.
+# This script assumes the model is compiled (bin/pandemic-synthetic-scenario and bin/pandemic-scaling-benchmark).
+# Every scenario has one infected cell per 100 cells, so that most cells are computed at every step after a few days.
+#
+# usage (from the root of the repository): sh Scripts/Benchmark/size_scaling.sh [SIZES] [DAYS] [THREADS]
+# SIZES is a comma-separated list (default: 1000,10000,100000,1000000).
+# The results are written to logs/size_scaling.csv (see src/scaling_benchmark.cpp for the columns).
+
+SIZES=${1:-1000,10000,100000,1000000}
+DAYS=${2:-100}
+THREADS=${3:-1}
+RESULTS="../logs/size_scaling.csv"
+
+mkdir -p logs
+cd bin
+
+HEADER="--header"
+rm -f ${RESULTS}
+for SIZE in $(echo ${SIZES} | tr ',' ' '); do
+    SCENARIO="../logs/synthetic_${SIZE}.bin"
+    INFECTED=$(( SIZE / 100 > 0 ? SIZE / 100 : 1 ))
+    ./pandemic-synthetic-scenario ${SIZE} ${SCENARIO} --infected=${INFECTED} || exit 1
+    # A size that does not fit in memory ends the measures; the results of the smaller sizes are kept.
+    MEASURES=$(./pandemic-scaling-benchmark ${SCENARIO} ${DAYS} --threads=${THREADS} ${HEADER})
+    STATUS=$?
+    rm -f ${SCENARIO}
+    if [ ${STATUS} -ne 0 ]; then
+        echo "The scenario of ${SIZE} cells failed (status ${STATUS})"
+        exit 1
+    fi
+    echo "${MEASURES}" | tee -a ${RESULTS}
+    HEADER=""
+done
@@ -0,0 +1,28 @@
+# Measures how the synchronous engine scales with the number of threads.
+# This script assumes the model is compiled (bin/pandemic-geographical_model) and that the scenario exists;
+# by default it uses the Ottawa DA scenario generated by run_ottawa_das.sh.
+#
+# usage (from the root of the repository): sh Scripts/Benchmark/thread_scaling.sh [SCENARIO] [DAYS] [MAX_THREADS]
+# The results are written to logs/thread_scaling.csv
+
+SCENARIO=${1:-../config/scenario_ottawa_da.json}
+DAYS=${2:-365}
+MAX_THREADS=${3:-$(nproc)}
+RESULTS="../logs/thread_scaling.csv"
+
+mkdir -p logs
+cd bin
+
+echo "threads,seconds,speedup" > ${RESULTS}
+BASELINE=""
+for THREADS in $(seq 1 ${MAX_THREADS}); do
+    START=$(date +%s.%N)
+    ./pandemic-geographical_model ${SCENARIO} ${DAYS} --engine=synchronous --threads=${THREADS} || exit 1
+    END=$(date +%s.%N)
+    SECONDS_TAKEN=$(echo "${END} - ${START}" | bc)
+    if [ -z "${BASELINE}" ]; then
+        BASELINE=${SECONDS_TAKEN}
+    fi
+    SPEEDUP=$(echo "scale=2; ${BASELINE} / ${SECONDS_TAKEN}" | bc)
+    echo "${THREADS},${SECONDS_TAKEN},${SPEEDUP}" | tee -a ${RESULTS}
+done
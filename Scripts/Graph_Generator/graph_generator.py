@@ -7,6 +7,7 @@
 # In[1]:
 
 
+import csv
 import os
 import re
 from collections import defaultdict
@@ -19,6 +20,8 @@ from copy import copy
 
 log_file_folder = "../../logs"
 log_filename = log_file_folder + "/pandemic_messages.txt"
+aggregates_filename = log_file_folder + "/pandemic_aggregates.csv"
+aggregate_columns = ["susceptible", "exposed", "infected", "recovered", "asymptomatic", "new_exposed", "new_infected", "new_recovered", "new_asymptomatic", "deaths"]
 patt_out_line = "\{(?P<id>.*) ; <(?P<state>[\w,. -]+)>\}"
 
 # state log structure
@@ -117,37 +120,46 @@ num_expos = 0
 num_rec = 0
 num_asymp = 0
 
-with open(log_filename, "r") as log_file:
-    line_num = 0
+# Written by the simulator (--engine=synchronous --report=...): the daily averages are already computed. It is only used
+# if it is not older than the message log, i.e. if it was written by the last run.
+if os.path.exists(aggregates_filename) and (not os.path.exists(log_filename) or
+                                            os.path.getmtime(aggregates_filename) >= os.path.getmtime(log_filename)):
+    with open(aggregates_filename, "r") as aggregates_file:
+        for row in csv.DictReader(aggregates_file):
+            if row["region"] == "all" and row["weighting"] == "cell_average":
+                data.append([int(float(row["time"]))] + [float(row[column]) for column in aggregate_columns])
+else:
+    with open(log_filename, "r") as log_file:
+        line_num = 0
     
-    # for each line, read a line then:
-    for line in log_file:
-        # strip leading and trailing spaces
-        line = line.strip()
+        # for each line, read a line then:
+        for line in log_file:
+            # strip leading and trailing spaces
+            line = line.strip()
         
-        # if a time marker is found that is not the current time
-        if line.isnumeric() and line != curr_time:
+            # if a time marker is found that is not the current time
+            if line.isnumeric() and line != curr_time:
             
-            # appears to read the line into the data structure
-            if curr_states:
-                data.append(curr_states_to_df_row(curr_time, curr_states, num_inf, num_expos, num_rec, line_num))
-            curr_time = line
-            continue
-
-        match = re.search(patt_out_line, line)
-        if not match:
-            print(line)
-            continue
+                # appears to read the line into the data structure
+                if curr_states:
+                    data.append(curr_states_to_df_row(curr_time, curr_states, num_inf, num_expos, num_rec, line_num))
+                curr_time = line
+                continue
+
+            match = re.search(patt_out_line, line)
+            if not match:
+                print(line)
+                continue
             
-        if not curr_states:
-            sp = match.group("state").split(",")
+            if not curr_states:
+                sp = match.group("state").split(",")
 
-        cid = match.group("id")
-        state = list(map(float, match.group("state").split(",")))
-        curr_states[cid] = state
-        line_num += 1
+            cid = match.group("id")
+            state = list(map(float, match.group("state").split(",")))
+            curr_states[cid] = state
+            line_num += 1
         
-    data.append(curr_states_to_df_row(curr_time, curr_states, num_inf, num_expos, num_rec, line_num))
+        data.append(curr_states_to_df_row(curr_time, curr_states, num_inf, num_expos, num_rec, line_num))
 
 
 # In[ ]:
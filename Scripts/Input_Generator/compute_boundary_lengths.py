@@ -0,0 +1,33 @@
+#!/usr/bin/env python
+# coding: utf-8
+
+# Adds the boundary lengths used to compute the correlation between two regions (see shared_boundaries in the
+# generate_*_json.py scripts) to an adjacency CSV file, so that pandemic-scenario-builder does not need the geometry.
+# The geometries are looked up by ID in a dictionary, once per adjacency row.
+#
+# usage: python compute_boundary_lengths.py ADJACENCY.csv GEOMETRY.gpkg GEOMETRY_ID_COLUMN OUTPUT.csv
+# e.g.:  python compute_boundary_lengths.py "../../cadmium_gis/Ottawa_DAs/DA Ottawa Adjacency.csv" \
+#            "../../cadmium_gis/Ottawa_DAs/DA Ottawa.gpkg" dauid "../../cadmium_gis/Ottawa_DAs/DA Ottawa Adjacency Boundaries.csv"
+
+import sys
+import csv
+import geopandas as gpd
+
+adjacency_path, geometry_path, id_column, output_path = sys.argv[1:5]
+
+gdf = gpd.read_file(geometry_path)
+geometries = {str(region_id): geometry for region_id, geometry in zip(gdf[id_column], gdf.geometry)}
+
+with open(adjacency_path, newline="") as adjacency, open(output_path, "w", newline="") as output:
+    reader = csv.reader(adjacency)
+    writer = csv.writer(output)
+    writer.writerow(next(reader) + ["region_boundary", "neighbor_boundary", "shared_boundary"])
+    for row in reader:
+        g1 = geometries.get(row[0])
+        g2 = geometries.get(row[1])
+        if g1 is None or g2 is None:
+            # Regions without geometry are left without lengths; the scenario builder skips them if they have no
+            # population, as the scripts do.
+            writer.writerow(row + ["", "", ""])
+            continue
+        writer.writerow(row + [repr(g1.length), repr(g2.length), repr(g1.boundary.intersection(g2.boundary).length)])
@@ -0,0 +1,59 @@
+//
+// Mobility correction factors of a vicinity, compiled into a flat sorted table.
+//
+
+#ifndef PANDEMIC_HOYA_2002_CORRECTION_FACTOR_TABLE_HPP
+#define PANDEMIC_HOYA_2002_CORRECTION_FACTOR_TABLE_HPP
+
+#include <array>
+#include <map>
+#include <vector>
+
+// The "infection_correction_factors" of a vicinity map an infection threshold to a mobility correction factor and a
+// hysteresis. Everything geographical_cell::movement_correction_factor needs to know about an entry is computed once
+// here: the entries are sorted by threshold, and every entry also holds the threshold of the next entry (its own if it
+// is the last one) and the lower bound below which its hysteresis stops.
+class correction_factor_table {
+public:
+    struct entry {
+        float infection_threshold;
+        float mobility_correction_factor;
+        float infections_higher_bound;      // Infection threshold of the next correction factor
+        float infections_lower_bound;       // Infection threshold minus the hysteresis
+    };
+
+    correction_factor_table() = default;
+
+    explicit correction_factor_table(std::map<float, std::array<float, 2>> const &correction_factors) {
+        entries.reserve(correction_factors.size());
+        for(auto const &pair : correction_factors) {
+            entries.push_back({pair.first, pair.second.front(), pair.first, pair.first - pair.second.back()});
+        }
+        for(unsigned int i = 0; i + 1 < entries.size(); ++i) {
+            entries[i].infections_higher_bound = entries[i + 1].infection_threshold;
+        }
+    }
+
+    // The number of entries whose threshold is reached by the infectious population; the last of them applies.
+    // Tables hold a handful of entries, so a linear scan beats a binary search.
+    unsigned int num_reached(float infectious_population) const {
+        unsigned int reached = 0;
+        while(reached < entries.size() && infectious_population >= entries[reached].infection_threshold) {
+            ++reached;
+        }
+        return reached;
+    }
+
+    entry const &operator[](unsigned int index) const {
+        return entries[index];
+    }
+
+    unsigned int size() const {
+        return entries.size();
+    }
+
+private:
+    std::vector<entry> entries;
+};
+
+#endif //PANDEMIC_HOYA_2002_CORRECTION_FACTOR_TABLE_HPP
@@ -7,9 +7,11 @@
 
 #include <cmath>
 #include <iostream>
+#include <memory>
 #include <vector>
 #include <cadmium/celldevs/cell/cell.hpp>
 #include <iomanip>
+#include "hot_path_counters.hpp"
 #include "vicinity.hpp"
 #include "seaird.hpp"
 #include "simulation_config.hpp"
@@ -34,11 +36,8 @@ public:
     using phase_rates = std::vector<            // The age sub_division
                         std::vector<double>>;   // The stage of infection
 
-    phase_rates virulence_rates;
-    phase_rates incubation_rates;
-    phase_rates recovery_rates;
-    phase_rates mobility_rates;
-    phase_rates fatality_rates;
+    // The rates of the cell. Cells with equal configurations share one (see engine/config_pool.hpp).
+    std::shared_ptr<const simulation_config> config;
     double asymptomatic_rates;
 
     // To make the parameters of the correction_factors variable more obvious
@@ -49,28 +48,45 @@ public:
     int prec_divider;
     bool SIIRS_model = true;
 
+    // The position of the current cell in neighbors (neighbors.size() if it is not one of its own neighbors).
+    unsigned int self_neighbor_index = 0;
+
+#ifdef PANDEMIC_HOT_PATH_COUNTERS
+    // The events of the hot path of the cell since it was created (see hot_path_counters.hpp). Only the thread that
+    // computes the cell writes them.
+    mutable hot_path_counters counters;
+#endif
+
+    // What local_computation gathers about a neighbor before computing the new exposed of every age group.
+    struct neighbor_edge {
+        seaird const *state;
+        vicinity const *neighbor_vicinity;
+        float movement_factor;
+    };
+
     geographical_cell() : cell<T, std::string, seaird, vicinity>() {}
 
     geographical_cell(std::string const &cell_id, cell_unordered<vicinity> const &neighborhood,
                       seaird const &initial_state, std::string const &delay_id, simulation_config config) :
-    cell<T, std::string, seaird, vicinity>(cell_id, neighborhood, initial_state, delay_id) {
+    geographical_cell(cell_id, neighborhood, initial_state, delay_id,
+                      std::make_shared<const simulation_config>(std::move(config))) {}
 
-        for(const auto &i : neighborhood) {
-            state.current_state.hysteresis_factors.insert({i.first, hysteresis_factor{}});
-        }
+    geographical_cell(std::string const &cell_id, cell_unordered<vicinity> const &neighborhood,
+                      seaird const &initial_state, std::string const &delay_id,
+                      std::shared_ptr<const simulation_config> shared_config) :
+    cell<T, std::string, seaird, vicinity>(cell_id, neighborhood, initial_state, delay_id), config{std::move(shared_config)} {
 
-        virulence_rates = std::move(config.virulence_rates);
-        incubation_rates = std::move(config.incubation_rates);
-        recovery_rates = std::move(config.recovery_rates);
-        mobility_rates = std::move(config.mobility_rates);
-        fatality_rates = std::move(config.fatality_rates);
-        asymptomatic_rates = std::move(config.asymptomatic_rates);
+        // One hysteresis per neighbor, in the order of neighbors. The current cell is normally one of them.
+        state.current_state.hysteresis_factors().assign(neighbors.size(), hysteresis_factor{});
+        self_neighbor_index = std::find(neighbors.begin(), neighbors.end(), cell_id) - neighbors.begin();
 
-        prec_divider = config.prec_divider;
-        SIIRS_model = config.SIIRS_model;
+        asymptomatic_rates = config->asymptomatic_rates;
+        prec_divider = config->prec_divider;
+        SIIRS_model = config->SIIRS_model;
 
-        assert(virulence_rates.size() == recovery_rates.size() && virulence_rates.size() == mobility_rates.size() &&
-               virulence_rates.size() == incubation_rates.size() &&
+        assert(config->virulence_rates.size() == config->recovery_rates.size() &&
+               config->virulence_rates.size() == config->mobility_rates.size() &&
+               config->virulence_rates.size() == config->incubation_rates.size() &&
                "\n\nThere must be an equal number of age segments between all configuration rates.\n\n");
     }
 
@@ -80,6 +96,39 @@ public:
 
         seaird res = state.current_state;
 
+        // The movement correction factors depend only on the published infections of each neighbor and on the hysteresis
+        // of the edge, not on the age group, so they are evaluated once per step and shared by every age group.
+        // The current cell must be part of its own neighborhood for this to work!
+        // The neighbors_state and neighbors_vicinity maps are keyed by cell ID, so every neighbor is looked up once here
+        // rather than once per age group.
+        seaird::hysteresis_edges &hysteresis_factors = res.hysteresis_factors();
+        std::vector<neighbor_edge> edges;
+        edges.reserve(neighbors.size());
+        for(unsigned int n = 0; n < neighbors.size(); ++n) {
+            seaird const &nstate = state.neighbors_state.at(neighbors[n]);
+            vicinity const &v = state.neighbors_vicinity.at(neighbors[n]);
+            edges.push_back({&nstate, &v, movement_correction_factor(v.get_correction_table(),
+                                                                     nstate.published_infections, hysteresis_factors[n])});
+        }
+        float self_movement_factor = edges.at(self_neighbor_index).movement_factor;
+
+        std::vector<double> exposures;
+        exposures.reserve(res.get_num_age_segments());
+        for(int age_segment_index = 0; age_segment_index < res.get_num_age_segments(); ++age_segment_index) {
+            exposures.push_back(new_exposed(age_segment_index, self_movement_factor, edges));
+        }
+
+        seaird next = next_state(std::move(res), exposures);
+        HOT_PATH_COUNT(counters, messages_emitted, next != state.current_state);
+        return next;
+    }
+
+    // Advances res, a copy of the current state whose hysteresis factors were already updated for this step, by one day.
+    // exposures holds the new exposed of each age group as returned by new_exposed. Engines that compute the exposure
+    // of every cell themselves (see model/engine/exposure_matrix.hpp) call it directly instead of local_computation.
+    seaird next_state(seaird res, const std::vector<double> &exposures) const {
+        HOT_PATH_COUNT(counters, local_computations, 1);
+
         // calculate the next new seaird variables for each age group
         for(int age_segment_index = 0; age_segment_index < res.get_num_age_segments(); ++age_segment_index) {
 
@@ -97,7 +146,7 @@ public:
             // was already set to the population of last stage of infected- meaning fatalities is always 0 for the last stage).
 
             // cauculate the total number of new exposed entering exposed(0)
-            double new_e = std::round(new_exposed(age_segment_index, res) * prec_divider) / prec_divider;
+            double new_e = std::round(exposures.at(age_segment_index) * prec_divider) / prec_divider;
 
             // calculate the total number new infected, exposed last day + exposed other days becoming infected
             double new_i = std::round(new_infections(age_segment_index, res) * prec_divider) / prec_divider;
@@ -111,39 +160,46 @@ public:
             // calculate the vector of new recoveries entering from each infection day 1:num_infection_phases,
             std::vector<double> recovered = new_recoveries(res, age_segment_index, fatalities);
 
-            res.fatalities.at(age_segment_index) += std::accumulate(fatalities.begin(), fatalities.end(), 0.0f);
+            res.fatalities().at(age_segment_index) += std::accumulate(fatalities.begin(), fatalities.end(), 0.0f);
 
             // The susceptible population is smaller due to previous deaths
-            double new_s = 1 - res.fatalities.at(age_segment_index);
+            double new_s = 1 - res.fatalities().at(age_segment_index);
 
             // So far, it was assumed that on the last day of infection, all recovered. But this is not true- have to account
             // for those who died on the last day of infection.
             recovered.back() -= fatalities.back();
 
-            // Advance all exposed forward a day, with some proportion leaving exposed(q-1) and entering infected(1)
+            // Advance all exposed forward a day, with some proportion leaving exposed(q-1) and entering infected(1).
+            // After advance_exposed, exposed(i) holds the exposed of the previous day i - 1.
+            res.advance_exposed(age_segment_index);
+            state_span<double> exposed = res.exposed(age_segment_index);
             for (int i = res.get_num_exposed_phases() - 1; i > 0; --i)
             {
                 // calculate new exposed based on the incubation rate and the previous days exposed
-                double curr_expos = std::round(res.exposed.at(age_segment_index).at(i - 1)
-                    *(1-incubation_rates.at(age_segment_index).at(i-1))*prec_divider) / prec_divider;
+                double curr_expos = std::round(exposed.at(i)
+                    *(1-config->incubation_rates.at(age_segment_index).at(i-1))*prec_divider) / prec_divider;
 
                 // The susceptible population does not include the exposed population
                 new_s -= curr_expos;
 
-                res.exposed.at(age_segment_index).at(i) = curr_expos;
+                exposed.at(i) = curr_expos;
             }
-            res.exposed.at(age_segment_index).at(0) = new_e;
+            exposed.at(0) = new_e;
             new_s -= new_e;
 
             // Equation 6d
             // Advance all infected q = 0 to q = Ti-1 one day forward
+            res.advance_infected(age_segment_index);
+            res.advance_asymptomatic(age_segment_index);
+            state_span<double> infected = res.infected(age_segment_index);
+            state_span<double> asymptomatic = res.asymptomatic(age_segment_index);
             for (int i = res.get_num_infected_phases() - 1; i > 0; --i)
             {
                 // *** Calculate proportion of infected on a given day of the infection ***
 
                 // The previous day of infection
-                double curr_inf = res.infected.at(age_segment_index).at(i - 1);
-                double curr_asymp = res.asymptomatic.at(age_segment_index).at(i - 1);
+                double curr_inf = infected.at(i);
+                double curr_asymp = asymptomatic.at(i);
 
                 // The number of people in a stage of infection moving to the new infection stage do not include those
                 // who have died or recovered. Note: A subtraction must be done here as the recovery and mortality rates
@@ -161,26 +217,34 @@ public:
                 // The amount of susceptible does not include the infected population
                 new_s -= curr_inf + curr_asymp;
 
-                res.infected.at(age_segment_index).at(i) = curr_inf;
-                res.asymptomatic.at(age_segment_index).at(i) = curr_asymp;
+                infected.at(i) = curr_inf;
+                asymptomatic.at(i) = curr_asymp;
             }
 
             // The people on the first day of infection
-            res.infected.at(age_segment_index).at(0) = new_i;
-            res.asymptomatic.at(age_segment_index).at(0) = new_a;
+            infected.at(0) = new_i;
+            asymptomatic.at(0) = new_a;
 
             // The susceptible population does not include those that just became exposed
             new_s -= (new_i + new_a);
 
             int recovered_index = res.get_num_recovered_phases() - 1;
 
+            // After advance_recovered, recovered(i) holds the population of the previous day i - 1, and recovered(0)
+            // the population that was on the last day of recovery.
+            res.advance_recovered(age_segment_index);
+            state_span<double> recovered_phases = res.recovered(age_segment_index);
+
             if(!SIIRS_model) {
+                if(res.get_num_recovered_phases() < 2) {
+                    throw std::out_of_range{"The SEIRD model requires at least two recovered phases"};
+                }
                 // Add the population on the second last day of recovery to the population on the last day of recovery.
                 // This entire population on the last day of recovery is then subtracted from the susceptible population
                 // to take into account that the population on the last day of recovery will not be subtracted from the susceptible
                 // population in the Equation 6a for loop.
-                res.recovered.at(age_segment_index).back() += res.recovered.at(age_segment_index).at(res.get_num_recovered_phases() - 2);
-                new_s -= res.recovered.at(age_segment_index).back();
+                recovered_phases.back() += recovered_phases.front();
+                new_s -= recovered_phases.back();
                 // Avoid processing the population on the last day of recovery in the equation 6a for loop. This will
                 // update all stages of recovery population except the last one, which grows with every time step
                 // as it is only added to from the population on the second last day of recovery.
@@ -193,13 +257,12 @@ public:
                 // Each day of the recovered is the value of the previous day. The population on the last day is
                 // now susceptible (assuming a SIIRS model); this is implicitly done already as the susceptible value was set to 1.0 and the
                 // population on the last day of recovery is never subtracted from the susceptible value.
-                res.recovered.at(age_segment_index).at(i) = res.recovered.at(age_segment_index).at(i - 1);
-                new_s -= res.recovered.at(age_segment_index).at(i);
+                new_s -= recovered_phases.at(i);
             }
 
             // The people on the first day of recovery are those that were on the last stage of infection (minus those who died;
             // already accounted for) in the previous time step plus those that recovered early during an infection stage.
-            res.recovered.at(age_segment_index).at(0) = std::accumulate(recovered.begin(), recovered.end(), 0.0f);
+            recovered_phases.at(0) = std::accumulate(recovered.begin(), recovered.end(), 0.0f);
 
             // The susceptible population does not include the recovered population
             new_s -= std::accumulate(recovered.begin(), recovered.end(), 0.0f);
@@ -207,9 +270,10 @@ public:
             if (new_s > -0.001 && new_s < 0) new_s = 0; // double precision issues
             assert(new_s >= 0);
 
-            res.susceptible.at(age_segment_index) = new_s;
+            res.susceptible().at(age_segment_index) = new_s;
         }
 
+        res.update_published_totals();
         return res;
     }
 
@@ -218,72 +282,68 @@ public:
         return 1;
     }
     
-    double new_exposed(unsigned int age_segment_index, seaird &current_seaird) const {
+    // self_movement_factor and the movement factors of the edges (in the order of neighbors) are the movement correction
+    // factors of the current step, as computed at the start of local_computation.
+    double new_exposed(unsigned int age_segment_index, float self_movement_factor, const std::vector<neighbor_edge> &edges) const {
         double expos = 0;
         double expos_i = 0;
         double expos_a = 0;
-        seaird const cstate = state.current_state;
+        seaird const &cstate = state.current_state;
+        HOT_PATH_COUNT(counters, neighbor_visits, edges.size());
 
         // calculate the correction factor of the current cell
-        // The current cell must be part of its own neighborhood for this to work!
-        vicinity self_vicinity = state.neighbors_vicinity.at(cell_id);
-        double current_cell_correction_factor = cstate.disobedient.at(age_segment_index)
-        + (1 - cstate.disobedient.at(age_segment_index)) * movement_correction_factor(self_vicinity.correction_factors,
-                                                    state.neighbors_state.at(cell_id).get_total_infections(),
-                                                    current_seaird.hysteresis_factors.at(cell_id));
+        double current_cell_correction_factor = cstate.disobedient->at(age_segment_index)
+        + (1 - cstate.disobedient->at(age_segment_index)) * self_movement_factor;
 
         // external exposed
-        for(auto neighbor: neighbors) {
-            seaird const nstate = state.neighbors_state.at(neighbor);
-            vicinity v = state.neighbors_vicinity.at(neighbor);
+        for(auto const &edge : edges) {
+            seaird const &nstate = *edge.state;
+            vicinity const &v = *edge.neighbor_vicinity;
 
             // disobedient people have a correction factor of 1. The rest of the population is affected by the movement_correction_factor
-            double neighbor_correction = nstate.disobedient.at(age_segment_index) +
-                    (1 - nstate.disobedient.at(age_segment_index)) *
-                    movement_correction_factor(v.correction_factors,
-                                               nstate.get_total_infections(),
-                                               current_seaird.hysteresis_factors.at(neighbor));
+            double neighbor_correction = nstate.disobedient->at(age_segment_index) +
+                    (1 - nstate.disobedient->at(age_segment_index)) * edge.movement_factor;
 
             // Logically makes sense to require neighboring cells to follow the movement restriction that is currently
             // in place in the current cell if the current cell has a more restrictive movement.
             neighbor_correction = std::min(current_cell_correction_factor, neighbor_correction);
 
             for (int i = 0; i < nstate.get_num_infected_phases(); ++i) {
-                /*expos += v.correlation * mobility_rates.at(age_segment_index).at(i) * // variable Cij
-                         virulence_rates.at(age_segment_index).at(i) * // variable lambda
-                         cstate.susceptible.at(age_segment_index) * //variable Si
+                /*expos += v.correlation * config->mobility_rates.at(age_segment_index).at(i) * // variable Cij
+                         config->virulence_rates.at(age_segment_index).at(i) * // variable lambda
+                         cstate.susceptible().at(age_segment_index) * //variable Si
                          ( nstate.get_total_asymptomatic() +
                            nstate.get_total_infections() ) * // variable Ij,
                          neighbor_correction;  // New exposed may be slightly fewer if there are mobility restrictions  */
 
                 //NEW TESTING
-                expos_i += v.correlation * mobility_rates.at(age_segment_index).at(i) * // variable Cij
-                         virulence_rates.at(age_segment_index).at(i) * // variable lambda
-                         cstate.susceptible.at(age_segment_index) * //variable Si
-                         nstate.get_total_infections() * neighbor_correction; // New exposed may be slightly fewer if there are mobility restrictions
+                expos_i += v.correlation * config->mobility_rates.at(age_segment_index).at(i) * // variable Cij
+                         config->virulence_rates.at(age_segment_index).at(i) * // variable lambda
+                         cstate.susceptible().at(age_segment_index) * //variable Si
+                         nstate.published_infections * neighbor_correction; // New exposed may be slightly fewer if there are mobility restrictions
 
 
-                expos_a += v.correlation * mobility_rates.at(age_segment_index).at(i) * // variable Cij
-                         virulence_rates.at(age_segment_index).at(i) * // variable lambda
-                         cstate.susceptible.at(age_segment_index) * //variable Si
-                         nstate.get_total_asymptomatic();  // We only consider mobility restrictions for those who are symptomatic
+                expos_a += v.correlation * config->mobility_rates.at(age_segment_index).at(i) * // variable Cij
+                         config->virulence_rates.at(age_segment_index).at(i) * // variable lambda
+                         cstate.susceptible().at(age_segment_index) * //variable Si
+                         nstate.published_asymptomatic;  // We only consider mobility restrictions for those who are symptomatic
 
                 expos = expos_i + expos_a;
 
 
             }
         }
-        return std::min(cstate.susceptible.at(age_segment_index), expos);
+        return std::min(cstate.susceptible().at(age_segment_index), expos);
     }
 
     double new_infections(unsigned int age_segment_index, seaird &current_seaird) const {
         double inf = 0;
-        seaird const cstate = state.current_state;
-        inf = cstate.exposed.at(age_segment_index).back();
+        seaird const &cstate = state.current_state;
+        inf = cstate.exposed(age_segment_index).back();
 
         // scan through all exposed day except last and calculate exposed.at(asi).at(i)
-        for(int i = 0; i < cstate.exposed.at(age_segment_index).size() - 1 ; i++){
-            inf += cstate.exposed.at(age_segment_index).at(i) * incubation_rates.at(age_segment_index).at(i);
+        for(int i = 0; i < cstate.exposed(age_segment_index).size() - 1 ; i++){
+            inf += cstate.exposed(age_segment_index).at(i) * config->incubation_rates.at(age_segment_index).at(i);
         }
         inf = std::round(((1-asymptomatic_rates) * inf) * prec_divider) / prec_divider;
         return inf;
@@ -291,12 +351,12 @@ public:
 
     double new_asymptomatic(unsigned int age_segment_index, seaird &current_seaird) const {
         double asym = 0;
-        seaird const cstate = state.current_state;
-        asym = cstate.exposed.at(age_segment_index).back();
+        seaird const &cstate = state.current_state;
+        asym = cstate.exposed(age_segment_index).back();
 
         // scan through all exposed day except last and calculate exposed.at(asi).at(i)
-        for(int i = 0; i < cstate.exposed.at(age_segment_index).size() - 1 ; i++){
-            asym += cstate.exposed.at(age_segment_index).at(i) * incubation_rates.at(age_segment_index).at(i);
+        for(int i = 0; i < cstate.exposed(age_segment_index).size() - 1 ; i++){
+            asym += cstate.exposed(age_segment_index).at(i) * config->incubation_rates.at(age_segment_index).at(i);
         }
         asym = std::round( (asymptomatic_rates * asym) * prec_divider) / prec_divider;
         return asym;
@@ -307,20 +367,20 @@ public:
 
         // Assume that any individuals that are not fatalities on the last stage of infection recover
         recovered.back() =
-                (current_state.infected.at(age_segment_index).back() +
-                 current_state.asymptomatic.at(age_segment_index).back()) -
+                (current_state.infected(age_segment_index).back() +
+                 current_state.asymptomatic(age_segment_index).back()) -
                  fatalities.back();
 
         for (int i = 0; i < current_state.get_num_infected_phases() - 1; ++i) {
             // Calculate all of the new recovered- for every day that a population is infected, some recover.
             float new_recoveries = std::round(
-                    (current_state.infected.at(age_segment_index).at(i) + current_state.asymptomatic.at(age_segment_index).at(i) ) *
-                    recovery_rates.at(age_segment_index).at(i) * prec_divider) / prec_divider;
+                    (current_state.infected(age_segment_index).at(i) + current_state.asymptomatic(age_segment_index).at(i) ) *
+                    config->recovery_rates.at(age_segment_index).at(i) * prec_divider) / prec_divider;
 
             // There can't be more recoveries than those who have died
             float maximum_possible_recoveries = (
-                    current_state.infected.at(age_segment_index).at(i) +
-                    current_state.asymptomatic.at(age_segment_index).at(i) ) -
+                    current_state.infected(age_segment_index).at(i) +
+                    current_state.asymptomatic(age_segment_index).at(i) ) -
                     fatalities.at(i);
 
             recovered.at(i) = std::min(new_recoveries, maximum_possible_recoveries);
@@ -332,28 +392,36 @@ public:
     std::vector<double> new_fatalities(const seaird &current_state, unsigned int age_segment_index) const {
         std::vector<double> fatalities(current_state.get_num_infected_phases(), 0.0f);
 
+        // current_state does not change while the fatalities of an age group are calculated, so the total is taken once.
+        bool hospitals_overwhelmed = current_state.get_total_infections() > current_state.hospital_capacity;
+
         // Calculate all those who have died during an infection stage.
         for(int i = 0; i < current_state.get_num_infected_phases(); ++i) {
             // Fatalities are only considered for those who are symptomatic(infected). It is extremely rare for an
             // asympyomatic patient to die as a result of COVID-19
             fatalities.at(i) += std::round(
-                    current_state.infected.at(age_segment_index).at(i) *
-                    fatality_rates.at(age_segment_index).at(i) * prec_divider) / prec_divider;
+                    current_state.infected(age_segment_index).at(i) *
+                    config->fatality_rates.at(age_segment_index).at(i) * prec_divider) / prec_divider;
 
 
-            if(current_state.get_total_infections() > current_state.hospital_capacity) {
+            if(hospitals_overwhelmed) {
                 fatalities.at(i) *= current_state.fatality_modifier;
             }
 
             // There can't be more fatalities than the number of people who are infected at a stage
-            fatalities.at(i) = std::min(fatalities.at(i), (current_state.infected.at(age_segment_index).at(i) + current_state.asymptomatic.at(age_segment_index).at(i) ));
+            fatalities.at(i) = std::min(fatalities.at(i), (current_state.infected(age_segment_index).at(i) + current_state.asymptomatic(age_segment_index).at(i) ));
         }
 
         return fatalities;
     }
 
-    float movement_correction_factor(const std::map<infection_threshold, mobility_correction_factor> &mobility_correction_factors,
+    float movement_correction_factor(const correction_factor_table &mobility_correction_factors,
                                      float infectious_population, hysteresis_factor &hysteresisFactor) const {
+        HOT_PATH_COUNT(counters, correction_factor_evaluations, 1);
+        // A flip is a change of in_effect between the start and the end of the call, counted once at the exits where
+        // it can change. Above the higher bound the hysteresis goes out of effect and back into effect with the next
+        // correction factor, which is no flip.
+        [[maybe_unused]] bool const was_in_effect = hysteresisFactor.in_effect;
 
         // For example, assume a correction factor of "0.4": [0.2, 0.1]. If the infection goes above 0.4, then the
         // correction factor of 0.2 will now be applied to total infection values above 0.3, no longer 0.4 as the
@@ -368,36 +436,26 @@ public:
             return hysteresisFactor.mobility_correction_factor;
         }
 
-        hysteresisFactor.in_effect = false;
-
-        float correction = 1.0f;
-        for (auto const &pair: mobility_correction_factors) {
-            if (infectious_population >= pair.first) {
-                correction = pair.second.front();
-
-                // A hysteresis factor will be in effect until the total infection goes below the hysteresis factor;
-                // until that happens the information required to return a movement factor must be kept in above variables.
-
-                // Get the threshold of the next correction factor; otherwise the current correction factor can remain in
-                // effect if the total infections never goes below the lower bound hysteresis factor, but also if it goes
-                // above the original total infection threshold!
-                auto next_pair_iterator = std::find(mobility_correction_factors.begin(), mobility_correction_factors.end(), pair);
-                assert(next_pair_iterator != mobility_correction_factors.end());
-
-                // If there is a next correction factor (for a higher total infection), then use it's total infection threshold
-                if(std::distance(mobility_correction_factors.begin(), next_pair_iterator) != mobility_correction_factors.size() - 1) {
-                    ++next_pair_iterator;
-                }
-
-                hysteresisFactor.in_effect = true;
-                hysteresisFactor.infections_higher_bound = next_pair_iterator->first;
-                hysteresisFactor.infections_lower_bound = pair.first - pair.second.back();
-                hysteresisFactor.mobility_correction_factor = pair.second.front();
-            } else {
-                break;
-            }
+        // The correction factor with the highest threshold reached by the infections applies
+        unsigned int num_reached = mobility_correction_factors.num_reached(infectious_population);
+        if(num_reached == 0) {
+            hysteresisFactor.in_effect = false;
+            HOT_PATH_COUNT(counters, hysteresis_flips, was_in_effect);
+            return 1.0f;
         }
-        return correction;
+
+        // A hysteresis factor will be in effect until the total infection goes below the hysteresis factor;
+        // until that happens the information required to return a movement factor must be kept in above variables.
+        // The higher bound is the threshold of the next correction factor; otherwise the current correction factor can
+        // remain in effect if the total infections never goes below the lower bound hysteresis factor, but also if it
+        // goes above the original total infection threshold!
+        auto const &factor = mobility_correction_factors[num_reached - 1];
+        hysteresisFactor.in_effect = true;
+        hysteresisFactor.infections_higher_bound = factor.infections_higher_bound;
+        hysteresisFactor.infections_lower_bound = factor.infections_lower_bound;
+        hysteresisFactor.mobility_correction_factor = factor.mobility_correction_factor;
+        HOT_PATH_COUNT(counters, hysteresis_flips, !was_in_effect);
+        return factor.mobility_correction_factor;
     }
 };
 
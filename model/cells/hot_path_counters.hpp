@@ -0,0 +1,70 @@
+//
+// Counters of the events of the hot path of the cells, compiled in only with PANDEMIC_HOT_PATH_COUNTERS.
+//
+
+#ifndef PANDEMIC_HOYA_2002_HOT_PATH_COUNTERS_HPP
+#define PANDEMIC_HOYA_2002_HOT_PATH_COUNTERS_HPP
+
+#include <ostream>
+
+// What a cell does in the hot path, to see how the cost of a step is spread over the cells (e.g. to balance the cells
+// between threads). Every cell counts its own events, so the cells of a step can be computed concurrently:
+//
+// * local_computations: next states computed,
+// * neighbor_visits: edges read while computing the new exposed (once per age group),
+// * correction_factor_evaluations: calls of movement_correction_factor (once per edge),
+// * hysteresis_flips: edges whose hysteresis went in or out of effect,
+// * messages_emitted: states published (the new state differs from the current one),
+// * messages_routed: published states delivered to the cells that have the cell as a neighbor, at the step at which
+//   they are delivered (the initial states, which every cell publishes, at the first step). Counted by the
+//   synchronous runner, which routes the messages itself; Cadmium's coupled models route them inside the simulator.
+//
+// Without PANDEMIC_HOT_PATH_COUNTERS (the default, see CMakeLists.txt) the cells have no counters and HOT_PATH_COUNT
+// expands to nothing, so the hot path is exactly what it is without them.
+struct hot_path_counters {
+    unsigned long local_computations = 0;
+    unsigned long neighbor_visits = 0;
+    unsigned long correction_factor_evaluations = 0;
+    unsigned long hysteresis_flips = 0;
+    unsigned long messages_emitted = 0;
+    unsigned long messages_routed = 0;
+
+    hot_path_counters &operator+=(hot_path_counters const &other) {
+        local_computations += other.local_computations;
+        neighbor_visits += other.neighbor_visits;
+        correction_factor_evaluations += other.correction_factor_evaluations;
+        hysteresis_flips += other.hysteresis_flips;
+        messages_emitted += other.messages_emitted;
+        messages_routed += other.messages_routed;
+        return *this;
+    }
+
+    hot_path_counters operator-(hot_path_counters const &other) const {
+        hot_path_counters difference = *this;
+        difference.local_computations -= other.local_computations;
+        difference.neighbor_visits -= other.neighbor_visits;
+        difference.correction_factor_evaluations -= other.correction_factor_evaluations;
+        difference.hysteresis_flips -= other.hysteresis_flips;
+        difference.messages_emitted -= other.messages_emitted;
+        difference.messages_routed -= other.messages_routed;
+        return difference;
+    }
+
+    static std::ostream &write_csv_header(std::ostream &os) {
+        return os << "local_computations,neighbor_visits,correction_factor_evaluations,hysteresis_flips,"
+                  << "messages_emitted,messages_routed";
+    }
+
+    std::ostream &write_csv(std::ostream &os) const {
+        return os << local_computations << "," << neighbor_visits << "," << correction_factor_evaluations << ","
+                  << hysteresis_flips << "," << messages_emitted << "," << messages_routed;
+    }
+};
+
+#ifdef PANDEMIC_HOT_PATH_COUNTERS
+#define HOT_PATH_COUNT(counters, counter, amount) ((counters).counter += (amount))
+#else
+#define HOT_PATH_COUNT(counters, counter, amount) ((void) 0)
+#endif
+
+#endif //PANDEMIC_HOYA_2002_HOT_PATH_COUNTERS_HPP
@@ -6,153 +6,423 @@
 #ifndef PANDEMIC_HOYA_2002_seaird_HPP
 #define PANDEMIC_HOYA_2002_seaird_HPP
 
+#include <algorithm>
+#include <array>
 #include <iostream>
+#include <memory>
+#include <numeric>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
 #include <nlohmann/json.hpp>
 #include "hysteresis_factor.hpp"
+#include "state_span.hpp"
 
 struct seaird {
-    std::vector<double> age_group_proportions;
-    std::vector<double> susceptible;
-    std::vector<std::vector<double>> exposed;
-    std::vector<std::vector<double>> infected;
-    std::vector<std::vector<double>> asymptomatic;
-    std::vector<std::vector<double>> recovered;
-    std::vector<double> fatalities;
-    std::unordered_map<std::string, hysteresis_factor> hysteresis_factors;
+    using phase_values = std::vector<            // The age sub_division
+                         std::vector<double>>;   // The stage of the compartment
+
+    // A seaird is also the message a cell sends to its neighbors (Cadmium uses the same type for both), yet neighbors
+    // only read the published totals and the disobedience below. The buffers are therefore shared between copies:
+    // a message or a neighbor state costs a few pointers and scalars, and only the cell updating its own state
+    // detaches (copies) the buffers it writes to. Buffers reachable from a published state are never modified.
+    std::shared_ptr<const std::vector<double>> age_group_proportions;
+
+    // All the compartments of the cell are kept in this single buffer, laid out as:
+    // [susceptible | exposed | infected | asymptomatic | recovered | fatalities], where the compartments with phases
+    // are stored age group by age group. The phases of an age group form a ring starting at its head (see state_span),
+    // so that advancing them by a day moves the head instead of shifting the values. Use the accessors below rather
+    // than indexing the values directly.
+    struct compartment_buffer {
+        std::vector<double> values;
+        std::vector<unsigned int> heads;    // [exposed | infected | asymptomatic | recovered], one per age group
+    };
+    std::shared_ptr<compartment_buffer> compartments;
+    unsigned int num_age_segments = 0;
+    unsigned int num_exposed_phases = 0;
+    unsigned int num_infected_phases = 0;
+    unsigned int num_asymptomatic_phases = 0;
+    unsigned int num_recovered_phases = 0;
+
+    // The hysteresis of the edge towards every neighbor, in the order of the neighbors of the cell.
+    using hysteresis_edges = std::vector<hysteresis_factor>;
+
+    // Only read and written by the cell that owns the state; see hysteresis_factors().
+    std::shared_ptr<hysteresis_edges> shared_hysteresis_factors;
     double population;
 
-    std::vector<double> disobedient;
+    std::shared_ptr<const std::vector<double>> disobedient;
     double hospital_capacity;
     double fatality_modifier;
 
+    // Totals of the state as it was published to the neighbors. Every neighbor reads these for every age group in
+    // each step, so they are computed once by update_published_totals() instead of re-walking every age group and phase.
+    double published_infections = 0.0f;
+    double published_asymptomatic = 0.0f;
+
     // Required for the JSON library, as types used with it must be default-constructable.
     // The overloaded constructor results in a default constructor having to be manually written.
     seaird() = default;
 
     seaird(std::vector<double> sus, std::vector<double> exp, std::vector<double> inf, std::vector<double> asym,
           std::vector<double> rec, double fat, double dis, double hcap, double fatm, double asym_r) :
-            susceptible{std::move(sus)}, exposed{std::move(exp)}, infected{std::move(inf)}, asymptomatic{std::move(asym)},
-            recovered{std::move(rec)}, fatalities{fat}, disobedient{dis},
-            hospital_capacity{hcap}, fatality_modifier{fatm} {}
+            disobedient{std::make_shared<const std::vector<double>>(1, dis)}, hospital_capacity{hcap}, fatality_modifier{fatm} {
+        set_compartments(sus, {exp}, {inf}, {asym}, {rec}, {fat});
+    }
+
+    // Packs the per age group compartments into the buffer. Every age group must have the same number of phases
+    // within a compartment.
+    void set_compartments(const std::vector<double> &sus, const phase_values &exp, const phase_values &inf,
+                          const phase_values &asym, const phase_values &rec, const std::vector<double> &fat) {
+        num_age_segments = sus.size();
+        num_exposed_phases = phase_count(exp, "exposed");
+        num_infected_phases = phase_count(inf, "infected");
+        num_asymptomatic_phases = phase_count(asym, "asymptomatic");
+        num_recovered_phases = phase_count(rec, "recovered");
+
+        if(fat.size() != num_age_segments) {
+            throw std::invalid_argument{"There must be an equal number of age groups between susceptible and fatalities"};
+        }
+        // The infected and asymptomatic of a day of infection advance together.
+        if(num_asymptomatic_phases != num_infected_phases) {
+            throw std::invalid_argument{"There must be an equal number of infected and asymptomatic phases"};
+        }
+
+        auto buffer = std::make_shared<compartment_buffer>();
+        std::vector<double> &values = buffer->values;
+        values.reserve(fatalities_offset() + num_age_segments);
+        values.insert(values.end(), sus.begin(), sus.end());
+        for(const auto &phases : {&exp, &inf, &asym, &rec}) {
+            for(const auto &age_group : *phases) {
+                values.insert(values.end(), age_group.begin(), age_group.end());
+            }
+        }
+        values.insert(values.end(), fat.begin(), fat.end());
+        buffer->heads.assign(num_phase_chains * num_age_segments, 0);
+        compartments = std::move(buffer);
+    }
+
+    // The hysteresis state of the edges towards the neighbors, indexed by the position of the neighbor.
+    hysteresis_edges &hysteresis_factors() {
+        if(!shared_hysteresis_factors) {
+            shared_hysteresis_factors = std::make_shared<hysteresis_edges>();
+        } else if(shared_hysteresis_factors.use_count() > 1) {
+            shared_hysteresis_factors = std::make_shared<hysteresis_edges>(*shared_hysteresis_factors);
+        }
+        return *shared_hysteresis_factors;
+    }
 
     unsigned int get_num_age_segments() const {
-        return susceptible.size();
+        return num_age_segments;
     }
 
     unsigned int get_num_exposed_phases() const {
-        return exposed.front().size();
+        return num_exposed_phases;
     }
 
     unsigned int get_num_infected_phases() const {
-        return infected.front().size();
+        return num_infected_phases;
     }
 
     unsigned int get_num_asymptomatic_phases() const {
-        return asymptomatic.front().size();
+        return num_asymptomatic_phases;
     }
 
     unsigned int get_num_recovered_phases() const {
-        return recovered.front().size();
+        return num_recovered_phases;
+    }
+
+    state_span<double> susceptible() {
+        return {writable_compartments().values.data(), num_age_segments};
+    }
+
+    state_span<const double> susceptible() const {
+        return {compartments->values.data(), num_age_segments};
+    }
+
+    state_span<double> exposed(unsigned int age_segment_index) {
+        return phases(exposed_chain, exposed_offset(), num_exposed_phases, age_segment_index);
+    }
+
+    state_span<const double> exposed(unsigned int age_segment_index) const {
+        return phases(exposed_chain, exposed_offset(), num_exposed_phases, age_segment_index);
+    }
+
+    state_span<double> infected(unsigned int age_segment_index) {
+        return phases(infected_chain, infected_offset(), num_infected_phases, age_segment_index);
+    }
+
+    state_span<const double> infected(unsigned int age_segment_index) const {
+        return phases(infected_chain, infected_offset(), num_infected_phases, age_segment_index);
+    }
+
+    state_span<double> asymptomatic(unsigned int age_segment_index) {
+        return phases(asymptomatic_chain, asymptomatic_offset(), num_asymptomatic_phases, age_segment_index);
+    }
+
+    state_span<const double> asymptomatic(unsigned int age_segment_index) const {
+        return phases(asymptomatic_chain, asymptomatic_offset(), num_asymptomatic_phases, age_segment_index);
+    }
+
+    state_span<double> recovered(unsigned int age_segment_index) {
+        return phases(recovered_chain, recovered_offset(), num_recovered_phases, age_segment_index);
+    }
+
+    state_span<const double> recovered(unsigned int age_segment_index) const {
+        return phases(recovered_chain, recovered_offset(), num_recovered_phases, age_segment_index);
+    }
+
+    state_span<double> fatalities() {
+        return {writable_compartments().values.data() + fatalities_offset(), num_age_segments};
+    }
+
+    state_span<const double> fatalities() const {
+        return {compartments->values.data() + fatalities_offset(), num_age_segments};
+    }
+
+    // Advance the phases of an age group by a day: phase i takes the value phase i - 1 had, and phase 0 the value the
+    // last phase had. Only the head of the ring moves; the caller then sets the values of the new day.
+    void advance_exposed(unsigned int age_segment_index) {
+        advance(exposed_chain, num_exposed_phases, age_segment_index);
+    }
+
+    void advance_infected(unsigned int age_segment_index) {
+        advance(infected_chain, num_infected_phases, age_segment_index);
+    }
+
+    void advance_asymptomatic(unsigned int age_segment_index) {
+        advance(asymptomatic_chain, num_asymptomatic_phases, age_segment_index);
+    }
+
+    void advance_recovered(unsigned int age_segment_index) {
+        advance(recovered_chain, num_recovered_phases, age_segment_index);
     }
 
-    static double sum_state_vector(const std::vector<double> &state_vector) {
+    static double sum_state_vector(state_span<const double> state_vector) {
         return std::accumulate(state_vector.begin(), state_vector.end(), 0.0f);
     }
 
     double get_total_fatalities() const {
         double total_fatalities = 0.0f;
-        for(int i = 0; i < age_group_proportions.size(); ++i) {
-            total_fatalities += fatalities.at(i) * age_group_proportions.at(i);
+        for(int i = 0; i < age_group_proportions->size(); ++i) {
+            total_fatalities += fatalities().at(i) * age_group_proportions->at(i);
         }
         return total_fatalities;
     }
 
     double get_total_exposed() const {
         float total_exposed = 0.0f;
-        for(int i = 0; i < age_group_proportions.size(); ++i) {
-            total_exposed += sum_state_vector(exposed.at(i)) * age_group_proportions.at(i);
+        for(int i = 0; i < age_group_proportions->size(); ++i) {
+            total_exposed += sum_state_vector(exposed(i)) * age_group_proportions->at(i);
         }
         return total_exposed;
     }
     
     double get_total_infections() const {
         float total_infections = 0.0f;
-        for(int i = 0; i < age_group_proportions.size(); ++i) {
-            total_infections += sum_state_vector(infected.at(i)) * age_group_proportions.at(i);
+        for(int i = 0; i < age_group_proportions->size(); ++i) {
+            total_infections += sum_state_vector(infected(i)) * age_group_proportions->at(i);
         }
         return total_infections;
     }
 
     double get_total_asymptomatic() const {
         float total_asymptomatic = 0.0f;
-        for(int i = 0; i < age_group_proportions.size(); ++i) {
-            total_asymptomatic += sum_state_vector(asymptomatic.at(i)) * age_group_proportions.at(i);
+        for(int i = 0; i < age_group_proportions->size(); ++i) {
+            total_asymptomatic += sum_state_vector(asymptomatic(i)) * age_group_proportions->at(i);
         }
         return total_asymptomatic;
     }
 
     double get_total_recovered() const {
         double total_recoveries = 0.0f;
-        for(int i = 0; i < age_group_proportions.size(); ++i) {
-            total_recoveries += sum_state_vector(recovered.at(i)) * age_group_proportions.at(i);
+        for(int i = 0; i < age_group_proportions->size(); ++i) {
+            total_recoveries += sum_state_vector(recovered(i)) * age_group_proportions->at(i);
         }
         return total_recoveries;
     }
 
     double get_total_susceptible() const {
         double total_susceptible = 0.0f;
-        for(int i = 0; i < age_group_proportions.size(); ++i) {
-            total_susceptible += susceptible.at(i) * age_group_proportions.at(i);
+        for(int i = 0; i < age_group_proportions->size(); ++i) {
+            total_susceptible += susceptible().at(i) * age_group_proportions->at(i);
         }
         return total_susceptible;
     }
 
+    // The values a state is logged with, in the order in which operator<< prints them.
+    static constexpr unsigned int num_log_fields = 11;
+    using log_values = std::array<double, num_log_fields>;
+
+    static std::array<const char *, num_log_fields> log_field_names() {
+        return {"population", "susceptible", "exposed", "infected", "recovered", "new_exposed", "new_infected",
+                "new_recovered", "fatalities", "new_asymptomatic", "asymptomatic"};
+    }
+
+    log_values log_fields() const {
+        double new_exposed = 0.0f;
+        double new_infections = 0.0f;
+        double new_asymptomatic = 0.0f;
+        double new_recoveries = 0.0f;
+
+        for(int i = 0; i < age_group_proportions->size(); ++i) {
+            new_exposed += exposed(i).at(0) * age_group_proportions->at(i);
+            new_infections += infected(i).at(0) * age_group_proportions->at(i);
+            new_asymptomatic += asymptomatic(i).at(0) * age_group_proportions->at(i);
+            new_recoveries += recovered(i).at(0) * age_group_proportions->at(i);
+        }
+
+        return {population - population * get_total_fatalities(), get_total_susceptible(), get_total_exposed(),
+                get_total_infections(), get_total_recovered(), new_exposed, new_infections, new_recoveries,
+                get_total_fatalities(), new_asymptomatic, get_total_asymptomatic()};
+    }
+
+    // Must be called whenever the state is about to be published (initial state and result of a local computation).
+    void update_published_totals() {
+        published_infections = get_total_infections();
+        published_asymptomatic = get_total_asymptomatic();
+    }
+
+    // Fatalities are not compared. The phases are compared in phase order, whatever the heads of the two states are.
     bool operator!=(const seaird &other) const {
-        return (susceptible != other.susceptible) || (exposed != other.exposed) || (infected != other.infected) || (asymptomatic != other.asymptomatic)|| (recovered != other.recovered);
+        if(num_age_segments != other.num_age_segments || num_exposed_phases != other.num_exposed_phases ||
+           num_infected_phases != other.num_infected_phases || num_asymptomatic_phases != other.num_asymptomatic_phases ||
+           num_recovered_phases != other.num_recovered_phases) {
+            return true;
+        }
+        if(compartments == other.compartments) {
+            return false;
+        }
+        if(!std::equal(compartments->values.begin(), compartments->values.begin() + exposed_offset(),
+                       other.compartments->values.begin())) {
+            return true;
+        }
+        for(unsigned int i = 0; i < num_age_segments; ++i) {
+            if(!equal_phases(exposed(i), other.exposed(i)) || !equal_phases(infected(i), other.infected(i)) ||
+               !equal_phases(asymptomatic(i), other.asymptomatic(i)) || !equal_phases(recovered(i), other.recovered(i))) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+private:
+    enum phase_chain : unsigned int { exposed_chain, infected_chain, asymptomatic_chain, recovered_chain, num_phase_chains };
+
+    // Detaches the compartments from the other copies of this state before they are written to.
+    compartment_buffer &writable_compartments() {
+        if(compartments.use_count() > 1) {
+            compartments = std::make_shared<compartment_buffer>(*compartments);
+        }
+        return *compartments;
     }
-};
 
-bool operator<(const seaird &lhs, const seaird &rhs) { return true; }
+    unsigned int exposed_offset() const {
+        return num_age_segments;
+    }
 
+    unsigned int infected_offset() const {
+        return exposed_offset() + num_age_segments * num_exposed_phases;
+    }
 
-// outputs <population, S, E, I, R, new I, new E, new R, D>
-std::ostream &operator<<(std::ostream &os, const seaird &seaird) {
+    unsigned int asymptomatic_offset() const {
+        return infected_offset() + num_age_segments * num_infected_phases;
+    }
 
-    double new_exposed = 0.0f;
-    double new_infections = 0.0f;
-    double new_asymptomatic = 0.0f;
-    double new_recoveries = 0.0f;
+    unsigned int recovered_offset() const {
+        return asymptomatic_offset() + num_age_segments * num_asymptomatic_phases;
+    }
 
-    for(int i = 0; i < seaird.age_group_proportions.size(); ++i) {
-        new_exposed += seaird.exposed.at(i).at(0) * seaird.age_group_proportions.at(i);
-        new_infections += seaird.infected.at(i).at(0) * seaird.age_group_proportions.at(i);
-        new_asymptomatic += seaird.asymptomatic.at(i).at(0) * seaird.age_group_proportions.at(i);
-        new_recoveries += seaird.recovered.at(i).at(0) * seaird.age_group_proportions.at(i);
+    unsigned int fatalities_offset() const {
+        return recovered_offset() + num_age_segments * num_recovered_phases;
     }
 
-    os << "<" << seaird.population - seaird.population * seaird.get_total_fatalities() << "," << seaird.get_total_susceptible()
-        << "," << seaird.get_total_exposed() << "," << seaird.get_total_infections() << "," << seaird.get_total_recovered() << ","
-        << new_exposed << "," << new_infections << "," << new_recoveries << "," << seaird.get_total_fatalities() <<
-        "," << new_asymptomatic << "," << seaird.get_total_asymptomatic() <<">";
+    state_span<double> phases(phase_chain chain, unsigned int offset, unsigned int num_phases, unsigned int age_segment_index) {
+        check_age_segment(age_segment_index);
+        compartment_buffer &buffer = writable_compartments();
+        return {buffer.values.data() + offset + age_segment_index * num_phases, num_phases,
+                buffer.heads[chain * num_age_segments + age_segment_index]};
+    }
+
+    state_span<const double> phases(phase_chain chain, unsigned int offset, unsigned int num_phases, unsigned int age_segment_index) const {
+        check_age_segment(age_segment_index);
+        return {compartments->values.data() + offset + age_segment_index * num_phases, num_phases,
+                compartments->heads[chain * num_age_segments + age_segment_index]};
+    }
+
+    void advance(phase_chain chain, unsigned int num_phases, unsigned int age_segment_index) {
+        check_age_segment(age_segment_index);
+        if(num_phases == 0) {
+            return;
+        }
+        unsigned int &head = writable_compartments().heads[chain * num_age_segments + age_segment_index];
+        head = head == 0 ? num_phases - 1 : head - 1;
+    }
+
+    void check_age_segment(unsigned int age_segment_index) const {
+        if(age_segment_index >= num_age_segments) {
+            throw std::out_of_range{"Age segment index " + std::to_string(age_segment_index) + " is out of range"};
+        }
+    }
+
+    static bool equal_phases(state_span<const double> lhs, state_span<const double> rhs) {
+        return std::equal(lhs.begin(), lhs.end(), rhs.begin());
+    }
+
+    static unsigned int phase_count(const phase_values &values, const std::string &compartment) {
+        unsigned int num_phases = values.empty() ? 0 : values.front().size();
+        for(const auto &age_group : values) {
+            if(age_group.size() != num_phases) {
+                throw std::invalid_argument{"Every age group must have the same number of " + compartment + " phases"};
+            }
+        }
+        return num_phases;
+    }
+};
+
+inline bool operator<(const seaird &lhs, const seaird &rhs) { return true; }
+
+
+// Prints the values of seaird::log_fields as <population, S, E, I, R, new E, new I, new R, D, new A, A>. The log
+// converters use it to print the values read from a binary log exactly as operator<< prints a state.
+inline std::ostream &print_log_fields(std::ostream &os, const seaird::log_values &fields) {
+    os << "<";
+    for(unsigned int i = 0; i < fields.size(); ++i) {
+        os << (i == 0 ? "" : ",") << fields[i];
+    }
+    os << ">";
     return os;
 }
 
-void from_json(const nlohmann::json &json, seaird &current_seaird) {
-    json.at("age_group_proportions").get_to(current_seaird.age_group_proportions);
-    json.at("infected").get_to(current_seaird.infected);
-    json.at("asymptomatic").get_to(current_seaird.asymptomatic);
-    json.at("recovered").get_to(current_seaird.recovered);
-    json.at("susceptible").get_to(current_seaird.susceptible);
-    json.at("exposed").get_to(current_seaird.exposed);
-    json.at("fatalities").get_to(current_seaird.fatalities);
-    json.at("disobedient").get_to(current_seaird.disobedient);
+// outputs <population, S, E, I, R, new E, new I, new R, D, new A, A>
+inline std::ostream &operator<<(std::ostream &os, const seaird &seaird) {
+    return print_log_fields(os, seaird.log_fields());
+}
+
+inline void from_json(const nlohmann::json &json, seaird &current_seaird) {
+    std::vector<double> age_group_proportions, susceptible, fatalities, disobedient;
+    seaird::phase_values exposed, infected, asymptomatic, recovered;
+
+    json.at("age_group_proportions").get_to(age_group_proportions);
+    json.at("infected").get_to(infected);
+    json.at("asymptomatic").get_to(asymptomatic);
+    json.at("recovered").get_to(recovered);
+    json.at("susceptible").get_to(susceptible);
+    json.at("exposed").get_to(exposed);
+    json.at("fatalities").get_to(fatalities);
+    json.at("disobedient").get_to(disobedient);
     json.at("hospital_capacity").get_to(current_seaird.hospital_capacity);
     json.at("fatality_modifier").get_to(current_seaird.fatality_modifier);
     json.at("population").get_to(current_seaird.population);
     
-    assert(current_seaird.age_group_proportions.size() == current_seaird.susceptible.size() && current_seaird.age_group_proportions.size() == current_seaird.exposed.size()
-    	&& current_seaird.age_group_proportions.size() == current_seaird.infected.size() && current_seaird.age_group_proportions.size() == current_seaird.recovered.size()
+    assert(age_group_proportions.size() == susceptible.size() && age_group_proportions.size() == exposed.size()
+    	&& age_group_proportions.size() == infected.size() && age_group_proportions.size() == recovered.size()
     	&& "There must be an equal number of age groups between age_group_proportions, susceptible, exposed, infected, and recovered!\n");
+
+    current_seaird.age_group_proportions = std::make_shared<const std::vector<double>>(std::move(age_group_proportions));
+    current_seaird.disobedient = std::make_shared<const std::vector<double>>(std::move(disobedient));
+    current_seaird.set_compartments(susceptible, exposed, infected, asymptomatic, recovered, fatalities);
+    current_seaird.update_published_totals();
 }
 
 #endif //PANDEMIC_HOYA_2002_seaird_HPP
@@ -23,7 +23,7 @@ struct simulation_config
     bool SIIRS_model = true;
 };
 
-void from_json(const nlohmann::json& json, simulation_config &v) {
+inline void from_json(const nlohmann::json& json, simulation_config &v) {
 
     json.at("precision").get_to(v.prec_divider);
     json.at("virulence_rates").get_to(v.virulence_rates);
@@ -0,0 +1,113 @@
+//
+// Non-owning views into the contiguous compartment buffer of a seaird state.
+//
+
+#ifndef PANDEMIC_HOYA_2002_STATE_SPAN_HPP
+#define PANDEMIC_HOYA_2002_STATE_SPAN_HPP
+
+#include <cstddef>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+// A run of consecutive values inside a seaird buffer: either the per age group values of a compartment (susceptible,
+// fatalities) or the phases of one age group in a compartment with phases (exposed, infected, asymptomatic, recovered).
+// It mirrors the subset of the std::vector interface that the model uses, so that the cell logic reads the same.
+//
+// The phases of a compartment are stored as a ring: phase 0 is at position head, and the later phases follow it and
+// wrap around to the start of the run. Advancing a day then moves the head instead of shifting every phase. Indices
+// and iterators of a span are always in phase order.
+template <typename VALUE>
+class state_span {
+    VALUE *first = nullptr;
+    unsigned int length = 0;
+    unsigned int head = 0;
+
+    unsigned int position(unsigned int index) const {
+        unsigned int shifted = index + head;
+        return shifted < length ? shifted : shifted - length;
+    }
+
+public:
+    class iterator;
+
+    state_span() = default;
+
+    state_span(VALUE *first, unsigned int length, unsigned int head = 0) : first{first}, length{length}, head{head} {}
+
+    unsigned int size() const {
+        return length;
+    }
+
+    VALUE &at(unsigned int index) const {
+        if(index >= length) {
+            throw std::out_of_range{"state_span index " + std::to_string(index) + " is out of range (size " +
+                                    std::to_string(length) + ")"};
+        }
+        return first[position(index)];
+    }
+
+    VALUE &operator[](unsigned int index) const {
+        return first[position(index)];
+    }
+
+    VALUE &front() const {
+        return at(0);
+    }
+
+    VALUE &back() const {
+        return at(length - 1);
+    }
+
+    iterator begin() const {
+        return {*this, 0};
+    }
+
+    iterator end() const {
+        return {*this, length};
+    }
+};
+
+// Visits the values of a span in phase order.
+template <typename VALUE>
+class state_span<VALUE>::iterator {
+    state_span span;
+    unsigned int index = 0;
+
+public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = typename std::remove_const<VALUE>::type;
+    using difference_type = std::ptrdiff_t;
+    using pointer = VALUE *;
+    using reference = VALUE &;
+
+    iterator() = default;
+
+    iterator(state_span span, unsigned int index) : span{span}, index{index} {}
+
+    reference operator*() const {
+        return span[index];
+    }
+
+    iterator &operator++() {
+        ++index;
+        return *this;
+    }
+
+    iterator operator++(int) {
+        iterator previous = *this;
+        ++index;
+        return previous;
+    }
+
+    bool operator==(iterator const &other) const {
+        return index == other.index;
+    }
+
+    bool operator!=(iterator const &other) const {
+        return index != other.index;
+    }
+};
+
+#endif //PANDEMIC_HOYA_2002_STATE_SPAN_HPP
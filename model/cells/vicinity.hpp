@@ -7,7 +7,10 @@
 
 #include <functional>
 #include <cmath>
+#include <map>
+#include <utility>
 #include <nlohmann/json.hpp>
+#include "correction_factor_table.hpp"
 #include "hysteresis_factor.hpp"
 
 struct vicinity
@@ -16,20 +19,37 @@ struct vicinity
     using mobility_correction_factor = std::array<float, 2>; // The first value is the mobility correction factor;
                                                              // The second one is the hysteresis factor.
 
-    std::map<infection_threshold, mobility_correction_factor> correction_factors;
-
     double correlation = 1.0f;
 
     explicit vicinity(double correlation) : correlation{correlation} {}
 
     vicinity(){}
+
+    // The correction factors are only set here, so that the table geographical_cell reads always holds them.
+    void set_correction_factors(std::map<infection_threshold, mobility_correction_factor> factors) {
+        correction_factors = std::move(factors);
+        correction_table = correction_factor_table{correction_factors};
+    }
+
+    std::map<infection_threshold, mobility_correction_factor> const &get_correction_factors() const {
+        return correction_factors;
+    }
+
+    correction_factor_table const &get_correction_table() const {
+        return correction_table;
+    }
+
+private:
+    std::map<infection_threshold, mobility_correction_factor> correction_factors;
+    correction_factor_table correction_table;   // correction_factors, as used by geographical_cell
 };
 
-void from_json(const nlohmann::json &json, vicinity &vicinity)
+inline void from_json(const nlohmann::json &json, vicinity &vicinity)
 {
    json.at("correlation").get_to(vicinity.correlation);
 
    std::map<std::string, std::array<float, 2>> unparsed_infection_correction_factors;
+   std::map<vicinity::infection_threshold, vicinity::mobility_correction_factor> correction_factors;
 
    json.at("infection_correction_factors").get_to(unparsed_infection_correction_factors);
 
@@ -66,8 +86,9 @@ void from_json(const nlohmann::json &json, vicinity &vicinity)
             throw std::runtime_error{error_message};
         }
 
-        vicinity.correction_factors.insert({infection_threshold, i.second});
+        correction_factors.insert({infection_threshold, i.second});
     }
+    vicinity.set_correction_factors(std::move(correction_factors));
 }
 
 #endif //CELL_DEVS_ZHONG_DEVEL_VICINITY_H
\ No newline at end of file
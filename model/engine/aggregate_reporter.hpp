@@ -0,0 +1,194 @@
+//
+// Daily aggregates of the whole domain and of groups of cells, computed while the simulation runs.
+//
+
+#ifndef PANDEMIC_HOYA_2002_AGGREGATE_REPORTER_HPP
+#define PANDEMIC_HOYA_2002_AGGREGATE_REPORTER_HPP
+
+#include <array>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "log_sink.hpp"
+
+// Computes what Scripts/Graph_Generator/graph_generator.py computes from the message log, without the log: every cell
+// contributes the last state it published, and at the end of every time step one CSV line is written per region and
+// weighting:
+//
+// * cell_average: the mean of the proportions over the cells (what graph_generator.py plots),
+// * population_weighted: the proportions of the total population of the cells, each cell weighted by its population.
+//
+// The region "all" is the whole domain. Other regions come from an optional mapping of cell IDs to region names, for
+// instance DA -> PHU; cells that are not mapped only count for "all".
+template <typename T>
+class aggregate_reporter : public log_sink<T> {
+public:
+    using region_map = std::unordered_map<std::string, std::string>;
+
+    // populations holds the population of every cell, indexed by cell.
+    aggregate_reporter(std::ostream &csv, std::vector<double> populations, region_map regions = {}) :
+            csv{csv}, populations{std::move(populations)}, regions{std::move(regions)} {}
+
+    // Reads a CSV file of "cell_id,region" lines. A first line "cell_id,region" is skipped as the header.
+    static region_map read_regions(std::string const &file_path) {
+        std::ifstream file{file_path};
+        if(!file.is_open()) {
+            throw std::runtime_error{"Unable to open the file: " + file_path};
+        }
+
+        region_map regions;
+        std::string line;
+        unsigned int line_number = 0;
+        while(std::getline(file, line)) {
+            ++line_number;
+            if(!line.empty() && line.back() == '\r') {
+                line.pop_back();
+            }
+            if(line.empty() || (line_number == 1 && line == "cell_id,region")) {
+                continue;
+            }
+            auto comma = line.find(',');
+            if(comma == std::string::npos) {
+                throw std::runtime_error{file_path + ":" + std::to_string(line_number) + ": expected cell_id,region"};
+            }
+            regions[line.substr(0, comma)] = line.substr(comma + 1);
+        }
+        return regions;
+    }
+
+    void start(cell_id_table const &cell_ids) override {
+        if(populations.size() != cell_ids.size()) {
+            throw std::invalid_argument{"The aggregate reporter needs the population of every cell"};
+        }
+
+        // Region 0 is the whole domain; the others are sorted by name.
+        std::map<std::string, unsigned int> region_indices;
+        for(auto const &region : regions) {
+            region_indices.insert({region.second, 0});
+        }
+        region_names = {"all"};
+        for(auto &region : region_indices) {
+            region.second = region_names.size();
+            region_names.push_back(region.first);
+        }
+
+        cell_regions.assign(cell_ids.size(), 0);
+        for(cell_index cell = 0; cell < cell_ids.size(); ++cell) {
+            auto region = regions.find(cell_ids.id(cell));
+            if(region != regions.end()) {
+                cell_regions[cell] = region_indices.at(region->second);
+            }
+        }
+
+        values.assign(cell_ids.size(), {});
+        known.assign(cell_ids.size(), false);
+
+        csv << "time,region,weighting";
+        for(auto const &column : columns) {
+            csv << "," << column.name;
+        }
+        csv << "\n";
+        csv << std::setprecision(10);
+    }
+
+    // A resumed run starts from the states the cells published before the checkpoint.
+    void resume(T time, cell_index cell, seaird::log_values const &published_state) override {
+        message(time, cell, published_state);
+    }
+
+    void time_step(T time) override {
+        // The start of the simulation and its first time step have the same time; they are one day here.
+        if(pending && time != current_time) {
+            write_rows();
+        }
+        current_time = time;
+        pending = true;
+    }
+
+    void message(T time, cell_index cell, seaird::log_values const &published_state) override {
+        values[cell] = published_state;
+        known[cell] = true;
+    }
+
+    void finish() override {
+        if(pending) {
+            write_rows();
+        }
+        csv.flush();
+    }
+
+private:
+    struct column {
+        const char *name;
+        unsigned int field;     // Index in seaird::log_fields
+    };
+
+    // The columns of graph_generator.py's states.csv, in the same order.
+    static constexpr column columns[] = {
+            {"susceptible", 1}, {"exposed", 2}, {"infected", 3}, {"recovered", 4}, {"asymptomatic", 10},
+            {"new_exposed", 5}, {"new_infected", 6}, {"new_recovered", 7}, {"new_asymptomatic", 9}, {"deaths", 8}
+    };
+    static constexpr unsigned int num_columns = sizeof(columns) / sizeof(column);
+
+    std::ostream &csv;
+    std::vector<double> populations;
+    region_map regions;
+
+    std::vector<std::string> region_names;
+    std::vector<unsigned int> cell_regions;
+    std::vector<seaird::log_values> values;
+    std::vector<char> known;
+
+    T current_time{};
+    bool pending = false;
+
+    void write_rows() {
+        unsigned int num_regions = region_names.size();
+        std::vector<std::array<double, num_columns>> sums(num_regions), weighted_sums(num_regions);
+        std::vector<unsigned int> num_cells(num_regions, 0);
+        std::vector<double> total_population(num_regions, 0);
+
+        auto add_cell = [&](unsigned int region, cell_index cell) {
+            for(unsigned int c = 0; c < num_columns; ++c) {
+                sums[region][c] += values[cell][columns[c].field];
+                weighted_sums[region][c] += values[cell][columns[c].field] * populations[cell];
+            }
+            num_cells[region] += 1;
+            total_population[region] += populations[cell];
+        };
+
+        for(cell_index cell = 0; cell < values.size(); ++cell) {
+            if(!known[cell]) {
+                continue;
+            }
+            add_cell(0, cell);
+            if(cell_regions[cell] != 0) {
+                add_cell(cell_regions[cell], cell);
+            }
+        }
+
+        for(unsigned int region = 0; region < num_regions; ++region) {
+            if(num_cells[region] == 0) {
+                continue;
+            }
+            write_row(region, "cell_average", sums[region], num_cells[region]);
+            write_row(region, "population_weighted", weighted_sums[region], total_population[region]);
+        }
+        pending = false;
+    }
+
+    void write_row(unsigned int region, const char *weighting, std::array<double, num_columns> const &sums, double divisor) {
+        csv << current_time << "," << region_names[region] << "," << weighting;
+        for(double sum : sums) {
+            csv << "," << (divisor == 0 ? 0 : sum / divisor);
+        }
+        csv << "\n";
+    }
+};
+
+#endif //PANDEMIC_HOYA_2002_AGGREGATE_REPORTER_HPP
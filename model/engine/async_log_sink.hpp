@@ -0,0 +1,203 @@
+//
+// Moves the formatting and writing of the logs to a dedicated thread.
+//
+
+#ifndef PANDEMIC_HOYA_2002_ASYNC_LOG_SINK_HPP
+#define PANDEMIC_HOYA_2002_ASYNC_LOG_SINK_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <thread>
+#include <vector>
+#include "log_sink.hpp"
+
+// Wraps another sink: the calls of the runner are turned into fixed-size entries pushed into a bounded single-producer
+// single-consumer ring, and a writer thread pops them and calls the wrapped sink. The simulation thread only copies
+// the logged values; formatting and disk I/O overlap with the next time steps.
+//
+// When the ring is full the simulation thread waits for the writer (backpressure); get_stats tells how often it did.
+// finish (called by the runner at the end of every run_until) waits until the writer has handed every entry to the
+// wrapped sink and called its finish. The destructor also drains the ring, so the logs are complete even when the
+// simulation is interrupted by an exception. An exception thrown by the wrapped sink is rethrown by the next finish.
+template <typename T>
+class async_log_sink : public log_sink<T> {
+public:
+    struct stats {
+        unsigned long entries = 0;          // Entries pushed by the simulation thread
+        unsigned long full_waits = 0;       // Pushes that found the ring full and had to wait for the writer
+        unsigned long max_pending = 0;      // Largest number of entries waiting in the ring
+    };
+
+    // capacity is rounded up to a power of two.
+    explicit async_log_sink(log_sink<T> &target, unsigned long capacity = 1ul << 16) : target{target} {
+        unsigned long size = 1;
+        while(size < capacity) {
+            size <<= 1;
+        }
+        ring.resize(size);
+        mask = size - 1;
+        writer = std::thread{[this]() { writer_loop(); }};
+    }
+
+    async_log_sink(const async_log_sink &) = delete;
+    async_log_sink &operator=(const async_log_sink &) = delete;
+
+    ~async_log_sink() override {
+        stopping.store(true, std::memory_order_release);
+        writer.join();
+    }
+
+    void start(cell_id_table const &ids) override {
+        cell_ids = &ids;
+        push({entry_kind::start, T{}, 0, {}});
+    }
+
+    void resume(T time, cell_index cell, seaird::log_values const &published_state) override {
+        push({entry_kind::resume, time, cell, published_state});
+    }
+
+    void time_step(T time) override {
+        push({entry_kind::time_step, time, 0, {}});
+    }
+
+    void message(T time, cell_index cell, seaird::log_values const &published_state) override {
+        push({entry_kind::message, time, cell, published_state});
+    }
+
+    void state(T time, cell_index cell, seaird::log_values const &current_state) override {
+        push({entry_kind::state, time, cell, current_state});
+    }
+
+    void finish() override {
+        unsigned long finish_index = push({entry_kind::finish, T{}, 0, {}});
+        while(finished.load(std::memory_order_acquire) <= finish_index) {
+            std::this_thread::yield();
+        }
+        if(writer_exception) {
+            std::exception_ptr exception = writer_exception;
+            writer_exception = nullptr;
+            std::rethrow_exception(exception);
+        }
+    }
+
+    stats get_stats() const {
+        return current_stats;
+    }
+
+private:
+    enum class entry_kind { start, resume, time_step, message, state, finish };
+
+    struct entry {
+        entry_kind kind;
+        T time;
+        cell_index cell;
+        seaird::log_values fields;
+    };
+
+    log_sink<T> &target;
+    cell_id_table const *cell_ids = nullptr;
+
+    std::vector<entry> ring;
+    unsigned long mask = 0;
+
+    // head is only written by the simulation thread and tail by the writer; each is on its own cache line.
+    alignas(64) std::atomic<unsigned long> head{0};
+    alignas(64) std::atomic<unsigned long> tail{0};
+    alignas(64) std::atomic<unsigned long> finished{0};     // One past the index of the last finish entry handled
+    std::atomic<bool> stopping{false};
+
+    stats current_stats;
+    std::exception_ptr writer_exception;    // Written by the writer before it publishes finished
+    std::thread writer;
+
+    // Returns the index of the entry in the sequence of all the entries pushed.
+    unsigned long push(entry const &new_entry) {
+        unsigned long index = head.load(std::memory_order_relaxed);
+        if(index - tail.load(std::memory_order_acquire) > mask) {
+            ++current_stats.full_waits;
+            while(index - tail.load(std::memory_order_acquire) > mask) {
+                std::this_thread::yield();
+            }
+        }
+        ring[index & mask] = new_entry;
+        head.store(index + 1, std::memory_order_release);
+
+        ++current_stats.entries;
+        current_stats.max_pending = std::max(current_stats.max_pending, index + 1 - tail.load(std::memory_order_relaxed));
+        return index;
+    }
+
+    void writer_loop() {
+        unsigned int idle_rounds = 0;
+        while(true) {
+            unsigned long index = tail.load(std::memory_order_relaxed);
+            if(index == head.load(std::memory_order_acquire)) {
+                if(stopping.load(std::memory_order_acquire) && index == head.load(std::memory_order_acquire)) {
+                    flush_target();
+                    return;
+                }
+                // Back off while the simulation computes a time step.
+                if(++idle_rounds < 64) {
+                    std::this_thread::yield();
+                } else {
+                    std::this_thread::sleep_for(std::chrono::microseconds{100});
+                }
+                continue;
+            }
+            idle_rounds = 0;
+
+            entry const &next = ring[index & mask];
+            bool is_finish = next.kind == entry_kind::finish;
+            if(is_finish) {
+                flush_target();
+            } else if(!writer_exception) {
+                try {
+                    forward(next);
+                } catch(...) {
+                    writer_exception = std::current_exception();
+                }
+            }
+            tail.store(index + 1, std::memory_order_release);
+            if(is_finish) {
+                finished.store(index + 1, std::memory_order_release);
+            }
+        }
+    }
+
+    void forward(entry const &next) {
+        switch(next.kind) {
+            case entry_kind::start:
+                target.start(*cell_ids);
+                break;
+            case entry_kind::resume:
+                target.resume(next.time, next.cell, next.fields);
+                break;
+            case entry_kind::time_step:
+                target.time_step(next.time);
+                break;
+            case entry_kind::message:
+                target.message(next.time, next.cell, next.fields);
+                break;
+            case entry_kind::state:
+                target.state(next.time, next.cell, next.fields);
+                break;
+            case entry_kind::finish:
+                break;
+        }
+    }
+
+    void flush_target() {
+        if(writer_exception) {
+            return;
+        }
+        try {
+            target.finish();
+        } catch(...) {
+            writer_exception = std::current_exception();
+        }
+    }
+};
+
+#endif //PANDEMIC_HOYA_2002_ASYNC_LOG_SINK_HPP
@@ -0,0 +1,351 @@
+//
+// Compact binary alternative to the text message and state logs, with a streaming writer and reader.
+//
+
+#ifndef PANDEMIC_HOYA_2002_BINARY_LOG_HPP
+#define PANDEMIC_HOYA_2002_BINARY_LOG_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <optional>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "../cells/seaird.hpp"
+#include "cell_id_table.hpp"
+#include "log_sink.hpp"
+
+// A binary log holds both the message and the state log of a run in a single file:
+//
+// * a header: the magic "SEAIRDLG", the format version, a byte order mark, the size of a record, the flags and the
+//   delta epsilon (version 2 and later), the names of the logged fields and the table of the cell IDs (a record
+//   refers to a cell by its index in this table),
+// * fixed-size records in the order in which they were logged, until the end of the file.
+//
+// A delta log (delta_flag) only holds the time steps and the states of the cells whose logged values changed by more
+// than the epsilon since the last state written for them (see writer::changed); messages are not written. A cell keeps
+// the values of its last state record until the next one, so replay rebuilds the values of every cell at every time
+// step, within the epsilon. The first state of every cell is always written.
+//
+// Strings are stored as their length (uint32) followed by their characters. Every number is in the byte order of the
+// machine that wrote the log; readers reject a log whose byte order mark does not match theirs.
+namespace binary_log {
+    constexpr char magic[8] = {'S', 'E', 'A', 'I', 'R', 'D', 'L', 'G'};
+    constexpr std::uint32_t version = 2;
+    constexpr std::uint32_t delta_flag = 1;
+    constexpr std::uint32_t byte_order_mark = 0x01020304;
+
+    enum record_kind : std::uint32_t {
+        time_step_record = 0,   // The start of a time step (both logs); cell and fields are unused
+        message_record = 1,     // A state published by a cell (message log)
+        state_record = 2,       // The state of a cell (state log)
+    };
+
+    struct record {
+        double time;
+        std::uint32_t cell;
+        std::uint32_t kind;
+        double fields[seaird::num_log_fields];
+    };
+    static_assert(sizeof(record) == 16 + 8 * seaird::num_log_fields, "binary_log::record must not be padded");
+
+    // Writes a run of the synchronous runner to a binary log.
+    template <typename T>
+    class writer : public log_sink<T> {
+    public:
+        // With a delta_epsilon, a delta log is written (see above).
+        explicit writer(std::string const &file_path, std::optional<double> delta_epsilon = std::nullopt) :
+                buffer(1 << 20), delta_epsilon{delta_epsilon} {
+            if(delta_epsilon && !(*delta_epsilon >= 0)) {
+                throw std::invalid_argument{"The delta epsilon of a binary log must be positive or zero"};
+            }
+            file.rdbuf()->pubsetbuf(buffer.data(), buffer.size());
+            file.open(file_path, std::ios::binary | std::ios::trunc);
+            if(!file.is_open()) {
+                throw std::runtime_error{"Unable to open the file: " + file_path};
+            }
+        }
+
+        void start(cell_id_table const &cell_ids) override {
+            file.write(magic, sizeof(magic));
+            write_u32(version);
+            write_u32(byte_order_mark);
+            write_u32(sizeof(record));
+            write_u32(delta_epsilon ? delta_flag : 0);
+            double epsilon = delta_epsilon.value_or(0);
+            file.write(reinterpret_cast<const char *>(&epsilon), sizeof(epsilon));
+
+            write_u32(seaird::num_log_fields);
+            for(auto const &name : seaird::log_field_names()) {
+                write_string(name);
+            }
+
+            write_u32(cell_ids.size());
+            for(auto const &cell_id : cell_ids.get_ids()) {
+                write_string(cell_id);
+            }
+
+            if(delta_epsilon) {
+                last_written.assign(cell_ids.size(), {});
+                written.assign(cell_ids.size(), false);
+            }
+        }
+
+        // Whether a state must be written in a delta log: a value differs by more than the epsilon from the last state
+        // written for the cell. The epsilon is absolute for values up to 1 (the proportions) and relative above (the
+        // population), i.e. |a - b| > epsilon * max(1, |a|).
+        static bool changed(seaird::log_values const &last, seaird::log_values const &current, double epsilon) {
+            for(unsigned int i = 0; i < current.size(); ++i) {
+                if(std::abs(current[i] - last[i]) > epsilon * std::max(1.0, std::abs(last[i]))) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        void time_step(T time) override {
+            record time_step{};
+            time_step.time = time;
+            time_step.kind = time_step_record;
+            write_record(time_step);
+        }
+
+        void message(T time, cell_index cell, seaird::log_values const &published_state) override {
+            if(!delta_epsilon) {
+                write_state(time, cell, message_record, published_state);
+            }
+        }
+
+        void state(T time, cell_index cell, seaird::log_values const &current_state) override {
+            if(delta_epsilon) {
+                if(written[cell] && !changed(last_written[cell], current_state, *delta_epsilon)) {
+                    return;
+                }
+                last_written[cell] = current_state;
+                written[cell] = true;
+            }
+            write_state(time, cell, state_record, current_state);
+        }
+
+        void finish() override {
+            file.flush();
+            if(!file) {
+                throw std::runtime_error{"Unable to write the binary log"};
+            }
+        }
+
+    private:
+        std::vector<char> buffer;
+        std::ofstream file;
+        std::optional<double> delta_epsilon;
+        std::vector<seaird::log_values> last_written;
+        std::vector<char> written;
+
+        void write_state(T time, cell_index cell, record_kind kind, seaird::log_values const &fields) {
+            record logged{};
+            logged.time = time;
+            logged.cell = cell;
+            logged.kind = kind;
+            std::memcpy(logged.fields, fields.data(), sizeof(logged.fields));
+            write_record(logged);
+        }
+
+        void write_record(record const &logged) {
+            file.write(reinterpret_cast<const char *>(&logged), sizeof(logged));
+        }
+
+        void write_u32(std::uint32_t value) {
+            file.write(reinterpret_cast<const char *>(&value), sizeof(value));
+        }
+
+        void write_string(std::string const &value) {
+            write_u32(value.size());
+            file.write(value.data(), value.size());
+        }
+    };
+
+    // Reads a binary log record by record; the header is read when the log is opened.
+    class reader {
+    public:
+        explicit reader(std::string const &file_path) : file{file_path, std::ios::binary} {
+            if(!file.is_open()) {
+                throw std::runtime_error{"Unable to open the file: " + file_path};
+            }
+
+            char file_magic[sizeof(magic)];
+            file.read(file_magic, sizeof(file_magic));
+            if(!file || std::memcmp(file_magic, magic, sizeof(magic)) != 0) {
+                throw std::runtime_error{file_path + " is not a binary log"};
+            }
+            std::uint32_t file_version = read_u32();
+            if(file_version == 0 || file_version > version) {
+                throw std::runtime_error{"Unsupported binary log version in " + file_path};
+            }
+            if(read_u32() != byte_order_mark) {
+                throw std::runtime_error{file_path + " was written on a machine with a different byte order"};
+            }
+            if(read_u32() != sizeof(record)) {
+                throw std::runtime_error{"Unexpected record size in " + file_path};
+            }
+            if(file_version >= 2) {
+                flags = read_u32();
+                file.read(reinterpret_cast<char *>(&delta_epsilon), sizeof(delta_epsilon));
+            }
+
+            std::uint32_t num_fields = read_u32();
+            for(std::uint32_t i = 0; i < num_fields; ++i) {
+                field_names.push_back(read_string());
+            }
+            if(num_fields != seaird::num_log_fields) {
+                throw std::runtime_error{"Unexpected number of fields in " + file_path};
+            }
+
+            std::uint32_t num_cells = read_u32();
+            cell_ids.reserve(num_cells);
+            for(std::uint32_t i = 0; i < num_cells; ++i) {
+                cell_ids.push_back(read_string());
+            }
+        }
+
+        bool is_delta() const {
+            return (flags & delta_flag) != 0;
+        }
+
+        double get_delta_epsilon() const {
+            return delta_epsilon;
+        }
+
+        std::vector<std::string> const &get_field_names() const {
+            return field_names;
+        }
+
+        std::vector<std::string> const &get_cell_ids() const {
+            return cell_ids;
+        }
+
+        // Reads the next record into next_record; returns false at the end of the log.
+        bool next(record &next_record) {
+            file.read(reinterpret_cast<char *>(&next_record), sizeof(next_record));
+            if(file.gcount() == 0 && file.eof()) {
+                return false;
+            }
+            if(!file) {
+                throw std::runtime_error{"Truncated record in the binary log"};
+            }
+            if(next_record.kind != time_step_record && next_record.cell >= cell_ids.size()) {
+                throw std::runtime_error{"Record with an unknown cell index: " + std::to_string(next_record.cell)};
+            }
+            return true;
+        }
+
+    private:
+        std::ifstream file;
+        std::uint32_t flags = 0;
+        double delta_epsilon = 0;
+        std::vector<std::string> field_names;
+        std::vector<std::string> cell_ids;
+
+        std::uint32_t read_u32() {
+            std::uint32_t value = 0;
+            file.read(reinterpret_cast<char *>(&value), sizeof(value));
+            if(!file) {
+                throw std::runtime_error{"Truncated binary log header"};
+            }
+            return value;
+        }
+
+        std::string read_string() {
+            std::string value(read_u32(), '\0');
+            file.read(&value[0], value.size());
+            if(!file) {
+                throw std::runtime_error{"Truncated binary log header"};
+            }
+            return value;
+        }
+    };
+
+    // Rebuilds the time series of a log: at the end of every time step, step_done is called with the time and the values
+    // of every cell (indexed by cell), which are the values of the last state record of the cell. Cells without a
+    // state record yet are flagged in known. Works for both full and delta logs.
+    inline void replay(reader &log, std::function<void(double time, std::vector<seaird::log_values> const &values,
+                                                      std::vector<char> const &known)> const &step_done) {
+        std::vector<seaird::log_values> values(log.get_cell_ids().size());
+        std::vector<char> known(values.size(), false);
+        bool any_step = false;
+        double current_time = 0;
+
+        record next_record{};
+        while(log.next(next_record)) {
+            if(next_record.kind == time_step_record) {
+                // The start of the simulation and its first time step have the same time; they are one step here.
+                if(any_step && next_record.time != current_time) {
+                    step_done(current_time, values, known);
+                }
+                any_step = true;
+                current_time = next_record.time;
+            } else if(next_record.kind == state_record) {
+                std::memcpy(values[next_record.cell].data(), next_record.fields, sizeof(next_record.fields));
+                known[next_record.cell] = true;
+            }
+        }
+        if(any_step) {
+            step_done(current_time, values, known);
+        }
+    }
+
+    // Writes the rebuilt time series of a log as CSV: one line per cell and time step, for the cells known by then.
+    inline void convert_to_csv(reader &log, std::ostream &csv) {
+        csv << "time,cell_id";
+        for(auto const &name : log.get_field_names()) {
+            csv << "," << name;
+        }
+        csv << "\n";
+
+        replay(log, [&](double time, std::vector<seaird::log_values> const &values, std::vector<char> const &known) {
+            for(unsigned int cell = 0; cell < values.size(); ++cell) {
+                if(!known[cell]) {
+                    continue;
+                }
+                csv << time << "," << log.get_cell_ids()[cell];
+                for(double value : values[cell]) {
+                    csv << "," << value;
+                }
+                csv << "\n";
+            }
+        });
+    }
+
+    // Writes the text message and state logs (as written by main.cpp) of a full binary log.
+    template <typename T>
+    void convert_to_text(reader &log, std::ostream &messages_log, std::ostream &state_log) {
+        if(log.is_delta()) {
+            throw std::runtime_error{"A delta log has no messages and cannot be converted to the text logs; convert it to CSV"};
+        }
+        record next_record{};
+        seaird::log_values fields{};
+        while(log.next(next_record)) {
+            if(next_record.kind == time_step_record) {
+                text_log_sink<T>::write_time(messages_log, static_cast<T>(next_record.time));
+                text_log_sink<T>::write_time(state_log, static_cast<T>(next_record.time));
+                continue;
+            }
+
+            std::memcpy(fields.data(), next_record.fields, sizeof(next_record.fields));
+            std::string const &cell_id = log.get_cell_ids()[next_record.cell];
+            if(next_record.kind == message_record) {
+                text_log_sink<T>::write_message(messages_log, cell_id, fields);
+            } else if(next_record.kind == state_record) {
+                text_log_sink<T>::write_state(state_log, cell_id, fields);
+            } else {
+                throw std::runtime_error{"Unknown record kind: " + std::to_string(next_record.kind)};
+            }
+        }
+    }
+}
+
+#endif //PANDEMIC_HOYA_2002_BINARY_LOG_HPP
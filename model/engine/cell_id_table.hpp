@@ -0,0 +1,58 @@
+//
+// Interns the string IDs of the cells of a scenario into dense integer indices.
+//
+
+#ifndef PANDEMIC_HOYA_2002_CELL_ID_TABLE_HPP
+#define PANDEMIC_HOYA_2002_CELL_ID_TABLE_HPP
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using cell_index = std::uint32_t;
+
+// The engines refer to cells by their index in [0, size()) and only go back to the string IDs for logging and I/O.
+// Indices are given in the order in which the IDs are interned, which is the order of the cells in the scenario.
+class cell_id_table {
+public:
+    // Returns the index of cell_id, giving it the next index if it was not interned yet.
+    cell_index intern(std::string const &cell_id) {
+        auto inserted = indices.insert({cell_id, static_cast<cell_index>(ids.size())});
+        if(inserted.second) {
+            ids.push_back(cell_id);
+        }
+        return inserted.first->second;
+    }
+
+    bool contains(std::string const &cell_id) const {
+        return indices.count(cell_id) != 0;
+    }
+
+    cell_index index_of(std::string const &cell_id) const {
+        auto index = indices.find(cell_id);
+        if(index == indices.end()) {
+            throw std::out_of_range{"Unknown cell ID: " + cell_id};
+        }
+        return index->second;
+    }
+
+    std::string const &id(cell_index index) const {
+        return ids.at(index);
+    }
+
+    std::vector<std::string> const &get_ids() const {
+        return ids;
+    }
+
+    cell_index size() const {
+        return ids.size();
+    }
+
+private:
+    std::unordered_map<std::string, cell_index> indices;
+    std::vector<std::string> ids;
+};
+
+#endif //PANDEMIC_HOYA_2002_CELL_ID_TABLE_HPP
@@ -0,0 +1,236 @@
+//
+// Binary checkpoints of a simulation run by the synchronous runner, from which the run can be resumed.
+//
+
+#ifndef PANDEMIC_HOYA_2002_CHECKPOINT_HPP
+#define PANDEMIC_HOYA_2002_CHECKPOINT_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "../cells/seaird.hpp"
+#include "cell_id_table.hpp"
+#include "compiled_scenario.hpp"
+
+// A checkpoint holds what changes while a scenario runs; the cells, their neighborhoods and their configurations come
+// from the scenario, which must be loaded again to resume. The file is:
+//
+// * a header: the magic "SEAIRDCP", the format version, a byte order mark, the time of the next step and a hash of the
+//   cell IDs in the order of the cells (to refuse a checkpoint of another scenario),
+// * for every cell: whether it published its state at the last step, and its state with the values of its buffers as
+//   they are in memory (ring heads included) and the hysteresis of every edge, so that the resumed run computes
+//   exactly what the original run would have.
+//
+// Between two steps, the state a cell published last is its current state (a cell only changes its state when it
+// publishes it), so the published states are not stored separately.
+namespace checkpoint {
+
+    constexpr char magic[8] = {'S', 'E', 'A', 'I', 'R', 'D', 'C', 'P'};
+    constexpr std::uint32_t version = 1;
+    constexpr std::uint32_t byte_order_mark = 0x01020304;
+
+    template <typename T>
+    struct snapshot {
+        T time{};
+        std::vector<char> published;
+        std::vector<seaird> states;
+    };
+
+    inline std::uint64_t hash_cell_ids(cell_id_table const &cell_ids) {
+        std::uint64_t hash = compiled_scenario::hash_bytes(nullptr, 0);
+        for(auto const &cell_id : cell_ids.get_ids()) {
+            hash = compiled_scenario::hash_bytes(cell_id.data(), cell_id.size() + 1, hash);
+        }
+        return hash;
+    }
+
+    // The path of the checkpoint of the given time: the prefix followed by the time, e.g. pandemic_checkpoint_300.bin.
+    template <typename T>
+    std::string file_name(std::string const &prefix, T time) {
+        std::ostringstream name;
+        name << prefix << "_" << time << ".bin";
+        return name.str();
+    }
+
+    inline void encode_state(compiled_scenario::encoder &out, seaird const &state) {
+        out.write<std::uint32_t>(state.num_age_segments);
+        out.write<std::uint32_t>(state.num_exposed_phases);
+        out.write<std::uint32_t>(state.num_infected_phases);
+        out.write<std::uint32_t>(state.num_asymptomatic_phases);
+        out.write<std::uint32_t>(state.num_recovered_phases);
+        out.write<double>(state.population);
+        out.write<double>(state.hospital_capacity);
+        out.write<double>(state.fatality_modifier);
+        out.write<double>(state.published_infections);
+        out.write<double>(state.published_asymptomatic);
+        out.write_doubles(*state.age_group_proportions, state.age_group_proportions->size());
+        out.write_doubles(*state.disobedient, state.disobedient->size());
+        out.write_doubles(state.compartments->values, state.compartments->values.size());
+        out.write<std::uint32_t>(state.compartments->heads.size());
+        for(unsigned int head : state.compartments->heads) {
+            out.write<std::uint32_t>(head);
+        }
+
+        std::uint32_t num_edges = state.shared_hysteresis_factors ? state.shared_hysteresis_factors->size() : 0;
+        out.write<std::uint32_t>(num_edges);
+        for(std::uint32_t edge = 0; edge < num_edges; ++edge) {
+            hysteresis_factor const &factor = (*state.shared_hysteresis_factors)[edge];
+            out.write<std::uint8_t>(factor.in_effect);
+            out.write<float>(factor.mobility_correction_factor);
+            out.write<float>(factor.infections_higher_bound);
+            out.write<float>(factor.infections_lower_bound);
+        }
+    }
+
+    inline seaird decode_state(compiled_scenario::decoder &in) {
+        seaird state;
+        state.num_age_segments = in.read<std::uint32_t>();
+        state.num_exposed_phases = in.read<std::uint32_t>();
+        state.num_infected_phases = in.read<std::uint32_t>();
+        state.num_asymptomatic_phases = in.read<std::uint32_t>();
+        state.num_recovered_phases = in.read<std::uint32_t>();
+        state.population = in.read<double>();
+        state.hospital_capacity = in.read<double>();
+        state.fatality_modifier = in.read<double>();
+        state.published_infections = in.read<double>();
+        state.published_asymptomatic = in.read<double>();
+        state.age_group_proportions = std::make_shared<const std::vector<double>>(in.read_doubles());
+        state.disobedient = std::make_shared<const std::vector<double>>(in.read_doubles());
+
+        auto compartments = std::make_shared<seaird::compartment_buffer>();
+        compartments->values = in.read_doubles();
+        compartments->heads.resize(in.read_count(sizeof(std::uint32_t)));
+        for(auto &head : compartments->heads) {
+            head = in.read<std::uint32_t>();
+        }
+        state.compartments = std::move(compartments);
+
+        seaird::hysteresis_edges &hysteresis_factors = state.hysteresis_factors();
+        hysteresis_factors.resize(in.read_count(1 + 3 * sizeof(float)));
+        for(auto &factor : hysteresis_factors) {
+            factor.in_effect = in.read<std::uint8_t>() != 0;
+            factor.mobility_correction_factor = in.read<float>();
+            factor.infections_higher_bound = in.read<float>();
+            factor.infections_lower_bound = in.read<float>();
+        }
+        return state;
+    }
+
+    // Throws a runtime_error if the buffers of a state do not have the sizes given by its numbers of age groups and of
+    // phases, or if its hysteresis does not have one edge per neighbor of its cell (num_neighbors). Every access to a
+    // state relies on these sizes, so a corrupted checkpoint must be refused before it is restored.
+    inline void check_state(seaird const &state, std::size_t num_neighbors, std::string const &cell_id) {
+        auto invalid = [&cell_id](std::string const &reason) {
+            return std::runtime_error{"the state of the cell " + cell_id + " " + reason};
+        };
+        std::size_t num_age_segments = state.num_age_segments;
+        if(state.age_group_proportions->size() != num_age_segments || state.disobedient->size() != num_age_segments) {
+            throw invalid("does not have one age group proportion and one disobedient proportion per age group");
+        }
+        if(state.num_asymptomatic_phases != state.num_infected_phases) {
+            throw invalid("does not have as many asymptomatic phases as infected phases");
+        }
+        // [susceptible | exposed | infected | asymptomatic | recovered | fatalities], and the head of every chain of
+        // phases of every age group (see seaird::compartment_buffer).
+        unsigned int const chain_phases[] = {state.num_exposed_phases, state.num_infected_phases,
+                                             state.num_asymptomatic_phases, state.num_recovered_phases};
+        std::size_t num_values = 2 * num_age_segments;
+        for(unsigned int num_phases : chain_phases) {
+            num_values += num_age_segments * num_phases;
+        }
+        if(state.compartments->values.size() != num_values) {
+            throw invalid("has " + std::to_string(state.compartments->values.size()) + " compartment values instead of " +
+                          std::to_string(num_values));
+        }
+        if(state.compartments->heads.size() != 4 * num_age_segments) {
+            throw invalid("has " + std::to_string(state.compartments->heads.size()) + " phase heads instead of " +
+                          std::to_string(4 * num_age_segments));
+        }
+        for(std::size_t head = 0; head < state.compartments->heads.size(); ++head) {
+            unsigned int num_phases = chain_phases[head / num_age_segments];
+            if(state.compartments->heads[head] >= std::max(num_phases, 1u)) {
+                throw invalid("has a phase head out of range");
+            }
+        }
+        std::size_t num_edges = state.shared_hysteresis_factors ? state.shared_hysteresis_factors->size() : 0;
+        if(num_edges != num_neighbors) {
+            throw invalid("has the hysteresis of " + std::to_string(num_edges) + " edges; the cell has " +
+                          std::to_string(num_neighbors) + " neighbors");
+        }
+    }
+
+    // Written to a temporary file first, so that a crash while writing leaves the previous checkpoint intact.
+    template <typename T>
+    void write(std::string const &file_path, snapshot<T> const &saved, cell_id_table const &cell_ids) {
+        compiled_scenario::encoder out;
+        out.bytes.append(magic, sizeof(magic));
+        out.write<std::uint32_t>(version);
+        out.write<std::uint32_t>(byte_order_mark);
+        out.write<double>(saved.time);
+        out.write<std::uint64_t>(hash_cell_ids(cell_ids));
+        out.write<std::uint32_t>(saved.states.size());
+        for(std::size_t i = 0; i < saved.states.size(); ++i) {
+            out.write<std::uint8_t>(saved.published[i]);
+            checkpoint::encode_state(out, saved.states[i]);
+        }
+
+        std::string temporary_path = file_path + ".tmp";
+        {
+            std::ofstream file{temporary_path, std::ios::binary | std::ios::trunc};
+            if(!file.is_open()) {
+                throw std::runtime_error{"Unable to open the file: " + temporary_path};
+            }
+            file.write(out.bytes.data(), out.bytes.size());
+            if(!file) {
+                throw std::runtime_error{"Unable to write the checkpoint " + temporary_path};
+            }
+        }
+        if(std::rename(temporary_path.c_str(), file_path.c_str()) != 0) {
+            throw std::runtime_error{"Unable to rename " + temporary_path + " to " + file_path};
+        }
+    }
+
+    // Reads a checkpoint of the scenario whose cells are cell_ids, with num_neighbors[i] neighbors for cell i.
+    template <typename T>
+    snapshot<T> read(std::string const &file_path, cell_id_table const &cell_ids,
+                     std::vector<std::size_t> const &num_neighbors) {
+        compiled_scenario::mapped_file file{file_path};
+        compiled_scenario::decoder in{file.begin(), file.end()};
+        snapshot<T> saved;
+        try {
+            for(char expected : magic) {
+                if(in.read<char>() != expected) {
+                    throw std::runtime_error{"not a checkpoint"};
+                }
+            }
+            if(in.read<std::uint32_t>() != version) {
+                throw std::runtime_error{"unsupported version"};
+            }
+            if(in.read<std::uint32_t>() != byte_order_mark) {
+                throw std::runtime_error{"written on a machine with a different byte order"};
+            }
+            saved.time = static_cast<T>(in.read<double>());
+            if(in.read<std::uint64_t>() != hash_cell_ids(cell_ids) || in.read<std::uint32_t>() != cell_ids.size()) {
+                throw std::invalid_argument{"The checkpoint " + file_path + " is not a checkpoint of this scenario"};
+            }
+            saved.published.resize(cell_ids.size());
+            saved.states.resize(cell_ids.size());
+            for(std::size_t i = 0; i < cell_ids.size(); ++i) {
+                saved.published[i] = in.read<std::uint8_t>() != 0;
+                saved.states[i] = checkpoint::decode_state(in);
+                checkpoint::check_state(saved.states[i], num_neighbors.at(i), cell_ids.get_ids()[i]);
+            }
+        } catch(std::runtime_error const &error) {
+            throw std::runtime_error{"Unable to read the checkpoint " + file_path + ": " + error.what()};
+        }
+        return saved;
+    }
+}
+
+#endif //PANDEMIC_HOYA_2002_CHECKPOINT_HPP
@@ -0,0 +1,102 @@
+//
+// Parsing of the numeric arguments of the command-line tools.
+//
+
+#ifndef PANDEMIC_HOYA_2002_COMMAND_LINE_HPP
+#define PANDEMIC_HOYA_2002_COMMAND_LINE_HPP
+
+#include <cctype>
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+#include <optional>
+#include <string>
+#include <type_traits>
+#include "thread_pool.hpp"
+
+// The std::sto* functions throw on a value that is not a number, read "5x" as 5 and std::stoul wraps "-1" to the
+// largest unsigned long. Here the whole value must be a finite number in the range of its type, or it is not a number:
+// the tools then print their usage instead of running with a value that was not meant.
+namespace command_line {
+
+    template <typename N>
+    std::optional<N> parse_number(std::string const &text) {
+        static_assert(std::is_arithmetic_v<N>, "Only numbers are parsed");
+        // strto* skip leading spaces and accept an empty number.
+        if(text.empty() || std::isspace(static_cast<unsigned char>(text.front()))) {
+            return std::nullopt;
+        }
+        char *end = nullptr;
+        errno = 0;
+        N value;
+        if constexpr(std::is_floating_point_v<N>) {
+            long double number = std::strtold(text.c_str(), &end);
+            if(!std::isfinite(number) || std::fabs(number) > std::numeric_limits<N>::max()) {
+                return std::nullopt;
+            }
+            value = static_cast<N>(number);
+        } else if constexpr(std::is_unsigned_v<N>) {
+            if(text.front() == '-') {
+                return std::nullopt;
+            }
+            unsigned long long number = std::strtoull(text.c_str(), &end, 10);
+            if(number > std::numeric_limits<N>::max()) {
+                return std::nullopt;
+            }
+            value = static_cast<N>(number);
+        } else {
+            long long number = std::strtoll(text.c_str(), &end, 10);
+            if(number < std::numeric_limits<N>::min() || number > std::numeric_limits<N>::max()) {
+                return std::nullopt;
+            }
+            value = static_cast<N>(number);
+        }
+        if(errno == ERANGE || end == text.c_str() || *end != '\0') {
+            return std::nullopt;
+        }
+        return value;
+    }
+
+    // The value of an option --NAME=VALUE.
+    inline std::string option_value(std::string const &argument) {
+        return argument.substr(argument.find('=') + 1);
+    }
+
+    // Sets value to the number of the option --NAME=VALUE; false (and value unchanged) if VALUE is not a number.
+    template <typename N>
+    bool parse_option(std::string const &argument, N &value) {
+        std::optional<N> number = parse_number<N>(option_value(argument));
+        if(number) {
+            value = *number;
+        }
+        return number.has_value();
+    }
+
+    template <typename N>
+    bool parse_option(std::string const &argument, std::optional<N> &value) {
+        std::optional<N> number = parse_number<N>(option_value(argument));
+        if(number) {
+            value = number;
+        }
+        return number.has_value();
+    }
+
+    // Sets num_threads to the N of --threads=N, which must be from 1 to thread_pool::max_threads(): a count of 0, or one
+    // in the billions, is a mistake rather than a request.
+    inline bool parse_num_threads(std::string const &argument, unsigned int &num_threads) {
+        unsigned int value = 0;
+        if(!parse_option(argument, value) || value < 1 || value > thread_pool::max_threads()) {
+            return false;
+        }
+        num_threads = value;
+        return true;
+    }
+
+    inline std::string num_threads_error(std::string const &argument) {
+        return "Invalid value: " + argument + " (expected 1 to " + std::to_string(thread_pool::max_threads()) +
+               " threads)";
+    }
+}
+
+#endif //PANDEMIC_HOYA_2002_COMMAND_LINE_HPP
@@ -0,0 +1,643 @@
+//
+// Binary form of a scenario file, loaded with mmap instead of being parsed.
+//
+
+#ifndef PANDEMIC_HOYA_2002_COMPILED_SCENARIO_HPP
+#define PANDEMIC_HOYA_2002_COMPILED_SCENARIO_HPP
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "../cells/seaird.hpp"
+#include "../cells/simulation_config.hpp"
+#include "../cells/vicinity.hpp"
+#include "cell_id_table.hpp"
+#include "scenario_loader.hpp"
+#include "thread_pool.hpp"
+
+// A compiled scenario holds the cells of a scenario file once parsed and checked, so that a run starts without parsing
+// JSON. It is made of:
+//
+// * a header: the magic "SEAIRDSC", the format version, a byte order mark and the hash of the scenario file it was
+//   compiled from (see content_hash),
+// * the fields of the scenario (for the GIS viewer) and the table of the cell IDs, sorted as scenario_loader sorts them,
+// * the order of the cells in the scenario file, "default" included (for the GIS viewer, see
+//   scenario_loader::read_cell_order): the index of every cell in that order, the number of cells for "default",
+// * the tables shared by the cells: cell types, delays, configs, initial states (but the population) and infection
+//   correction factor profiles. Scenarios repeat the same few of them for every cell and every edge, so each is stored
+//   once and referred to by its index,
+// * for every cell: its type, delay, config and initial state, its population and its neighborhood as (neighbor index,
+//   correlation, profile index) edges, i.e. the rows of the adjacency in CSR order. Edges are sorted by neighbor ID, the order in
+//   which the JSON loader inserts them in the neighborhood, so that cells list their neighbors in the same order.
+//
+// Strings are stored as their length (uint32) followed by their characters, and every number is in the byte order of
+// the machine that compiled the scenario. A compiled scenario is a cache, not an exchange format: readers reject one
+// with another version or byte order, and load_cached compiles the scenario again.
+namespace compiled_scenario {
+    constexpr char magic[8] = {'S', 'E', 'A', 'I', 'R', 'D', 'S', 'C'};
+    constexpr std::uint32_t version = 2;
+    constexpr std::uint32_t byte_order_mark = 0x01020304;
+
+    struct scenario {
+        std::vector<std::string> fields;
+        std::vector<std::string> cell_order;    // The IDs of the cells in the order of the file, "default" included
+        std::vector<cell_definition> cells;
+    };
+
+    // FNV-1a hash of bytes; hash is the hash of the bytes before them, if any.
+    inline std::uint64_t hash_bytes(const char *bytes, std::size_t size, std::uint64_t hash = 14695981039346656037ull) {
+        for(std::size_t i = 0; i < size; ++i) {
+            hash = (hash ^ static_cast<unsigned char>(bytes[i])) * 1099511628211ull;
+        }
+        return hash;
+    }
+
+    // Hash of the content of a file.
+    inline std::uint64_t content_hash(std::string const &file_path) {
+        std::ifstream file{file_path, std::ios::binary};
+        if(!file.is_open()) {
+            throw std::runtime_error{"Unable to open the file: " + file_path};
+        }
+        std::uint64_t hash = hash_bytes(nullptr, 0);
+        std::vector<char> block(1 << 20);
+        while(file.read(block.data(), block.size()) || file.gcount() > 0) {
+            hash = hash_bytes(block.data(), file.gcount(), hash);
+        }
+        return hash;
+    }
+
+    inline bool is_compiled(std::string const &file_path) {
+        std::ifstream file{file_path, std::ios::binary};
+        char file_magic[sizeof(magic)] = {};
+        file.read(file_magic, sizeof(file_magic));
+        return file && std::memcmp(file_magic, magic, sizeof(magic)) == 0;
+    }
+
+    // Appends the binary form of values to a byte string.
+    class encoder {
+    public:
+        std::string bytes;
+
+        template <typename V>
+        void write(V value) {
+            bytes.append(reinterpret_cast<const char *>(&value), sizeof(value));
+        }
+
+        void write_string(std::string const &value) {
+            write<std::uint32_t>(value.size());
+            bytes.append(value);
+        }
+
+        template <typename ITERABLE>
+        void write_doubles(ITERABLE const &values, std::uint32_t size) {
+            write<std::uint32_t>(size);
+            for(double value : values) {
+                write<double>(value);
+            }
+        }
+    };
+
+    // Reads the binary form of values from a range of bytes, checking that they are within the range.
+    class decoder {
+    public:
+        decoder(const char *begin, const char *end) : position{begin}, end{end} {}
+
+        template <typename V>
+        V read() {
+            V value;
+            std::memcpy(&value, take(sizeof(value)), sizeof(value));
+            return value;
+        }
+
+        std::string read_string() {
+            std::uint32_t size = read_count(1);
+            return std::string(take(size), size);
+        }
+
+        std::vector<double> read_doubles() {
+            std::uint32_t size = read_count(sizeof(double));
+            std::vector<double> values(size);
+            std::memcpy(values.data(), take(size * sizeof(double)), size * sizeof(double));
+            return values;
+        }
+
+        // Reads the number of elements of a sequence that takes at least element_size bytes per element in the file. The
+        // count is checked against the bytes left before the elements are allocated: a corrupted count must not
+        // allocate gigabytes before the file turns out to be truncated.
+        std::uint32_t read_count(std::size_t element_size) {
+            std::uint32_t count = read<std::uint32_t>();
+            if(count > static_cast<std::size_t>(end - position) / element_size) {
+                throw std::runtime_error{"Corrupted compiled scenario: count larger than the rest of the file"};
+            }
+            return count;
+        }
+
+        // Reads an index into a table of the given size.
+        std::uint32_t read_index(std::size_t table_size) {
+            std::uint32_t index = read<std::uint32_t>();
+            if(index >= table_size) {
+                throw std::runtime_error{"Corrupted compiled scenario: index out of range"};
+            }
+            return index;
+        }
+
+    private:
+        const char *position;
+        const char *end;
+
+        const char *take(std::size_t size) {
+            if(static_cast<std::size_t>(end - position) < size) {
+                throw std::runtime_error{"Truncated compiled scenario"};
+            }
+            const char *taken = position;
+            position += size;
+            return taken;
+        }
+    };
+
+    // Stores every distinct value once; add returns the index of the value in the table.
+    class table {
+    public:
+        std::uint32_t add(std::string const &encoded) {
+            auto inserted = indices.insert({encoded, static_cast<std::uint32_t>(values.size())});
+            if(inserted.second) {
+                values.push_back(encoded);
+            }
+            return inserted.first->second;
+        }
+
+        void write(encoder &out) const {
+            out.write<std::uint32_t>(values.size());
+            for(auto const &value : values) {
+                out.bytes.append(value);
+            }
+        }
+
+    private:
+        std::unordered_map<std::string, std::uint32_t> indices;
+        std::vector<std::string> values;
+    };
+
+    inline std::string encode_string(std::string const &value) {
+        encoder out;
+        out.write_string(value);
+        return out.bytes;
+    }
+
+    inline std::string encode_config(simulation_config const &config) {
+        encoder out;
+        out.write<std::int32_t>(config.prec_divider);
+        for(auto const *rates : {&config.virulence_rates, &config.incubation_rates, &config.recovery_rates,
+                                 &config.mobility_rates, &config.fatality_rates}) {
+            out.write<std::uint32_t>(rates->size());
+            for(auto const &age_group : *rates) {
+                out.write_doubles(age_group, age_group.size());
+            }
+        }
+        out.write<double>(config.asymptomatic_rates);
+        out.write<std::uint8_t>(config.SIIRS_model);
+        return out.bytes;
+    }
+
+    // The fewest bytes of an encoded config: the precision divider, the counts of the rate tables, the asymptomatic rate
+    // and the SIIRS flag.
+    constexpr std::size_t min_config_size = sizeof(std::int32_t) + 5 * sizeof(std::uint32_t) + sizeof(double) + 1;
+
+    inline simulation_config decode_config(decoder &in) {
+        simulation_config config;
+        config.prec_divider = in.read<std::int32_t>();
+        for(auto *rates : {&config.virulence_rates, &config.incubation_rates, &config.recovery_rates,
+                           &config.mobility_rates, &config.fatality_rates}) {
+            rates->resize(in.read_count(sizeof(std::uint32_t)));
+            for(auto &age_group : *rates) {
+                age_group = in.read_doubles();
+            }
+        }
+        config.asymptomatic_rates = in.read<double>();
+        config.SIIRS_model = in.read<std::uint8_t>() != 0;
+        return config;
+    }
+
+    // A profile is the infection correction factors of a vicinity: (threshold, mobility correction factor, hysteresis).
+    inline std::string encode_profile(vicinity const &edge) {
+        encoder out;
+        out.write<std::uint32_t>(edge.get_correction_factors().size());
+        for(auto const &factor : edge.get_correction_factors()) {
+            out.write<float>(factor.first);
+            out.write<float>(factor.second.front());
+            out.write<float>(factor.second.back());
+        }
+        return out.bytes;
+    }
+
+    inline std::map<float, std::array<float, 2>> decode_profile(decoder &in) {
+        std::map<float, std::array<float, 2>> correction_factors;
+        std::uint32_t size = in.read_count(3 * sizeof(float));
+        for(std::uint32_t i = 0; i < size; ++i) {
+            float threshold = in.read<float>();
+            float mobility_correction_factor = in.read<float>();
+            float hysteresis = in.read<float>();
+            correction_factors.insert({threshold, {mobility_correction_factor, hysteresis}});
+        }
+        return correction_factors;
+    }
+
+    // The initial state of a cell but its population (which differs for every cell), the phases of every compartment
+    // in order.
+    inline std::string encode_state(seaird const &state) {
+        encoder out;
+        out.write<double>(state.hospital_capacity);
+        out.write<double>(state.fatality_modifier);
+        out.write_doubles(*state.age_group_proportions, state.age_group_proportions->size());
+        out.write_doubles(*state.disobedient, state.disobedient->size());
+        out.write_doubles(state.susceptible(), state.get_num_age_segments());
+        auto write_phases = [&](auto const &phases_of_age) {
+            out.write<std::uint32_t>(state.get_num_age_segments());
+            for(unsigned int age = 0; age < state.get_num_age_segments(); ++age) {
+                auto values = phases_of_age(age);
+                out.write_doubles(values, values.size());
+            }
+        };
+        write_phases([&](unsigned int age) { return state.exposed(age); });
+        write_phases([&](unsigned int age) { return state.infected(age); });
+        write_phases([&](unsigned int age) { return state.asymptomatic(age); });
+        write_phases([&](unsigned int age) { return state.recovered(age); });
+        out.write_doubles(state.fatalities(), state.get_num_age_segments());
+        return out.bytes;
+    }
+
+    // The fewest bytes of an encoded state: the hospital capacity, the fatality modifier and the counts of its vectors.
+    constexpr std::size_t min_state_size = 2 * sizeof(double) + 8 * sizeof(std::uint32_t);
+
+    inline seaird decode_state(decoder &in) {
+        seaird state;
+        state.hospital_capacity = in.read<double>();
+        state.fatality_modifier = in.read<double>();
+        state.age_group_proportions = std::make_shared<const std::vector<double>>(in.read_doubles());
+        state.disobedient = std::make_shared<const std::vector<double>>(in.read_doubles());
+        std::vector<double> susceptible = in.read_doubles();
+        seaird::phase_values phases[4];
+        for(auto &compartment : phases) {
+            compartment.resize(in.read_count(sizeof(std::uint32_t)));
+            for(auto &age_group : compartment) {
+                age_group = in.read_doubles();
+            }
+        }
+        std::vector<double> fatalities = in.read_doubles();
+        state.set_compartments(susceptible, phases[0], phases[1], phases[2], phases[3], fatalities);
+        return state;
+    }
+
+    // Writes a compiled scenario cell by cell, so that the definitions of all the cells never need to exist at once
+    // (see synthetic_scenario.hpp). The cells are added in the order of cell_ids, which must be sorted by ID. Without
+    // a cell order, the scenario file is taken to list "default" first and then the cells in the order of cell_ids.
+    class writer {
+    public:
+        writer(std::vector<std::string> fields, cell_id_table cell_ids, std::vector<std::string> const &cell_order = {}) :
+                fields{std::move(fields)}, cell_ids{std::move(cell_ids)} {
+            if(cell_order.empty()) {
+                order.push_back(this->cell_ids.size());
+                for(cell_index i = 0; i < this->cell_ids.size(); ++i) {
+                    order.push_back(i);
+                }
+                return;
+            }
+            for(auto const &cell_id : cell_order) {
+                if(cell_id != "default" && !this->cell_ids.contains(cell_id)) {
+                    throw std::invalid_argument{"The cell order has an unknown cell: " + cell_id};
+                }
+                order.push_back(cell_id == "default" ? this->cell_ids.size() : this->cell_ids.index_of(cell_id));
+            }
+        }
+
+        void add(cell_definition const &cell) {
+            if(num_cells >= cell_ids.size() || cell_ids.id(num_cells) != cell.cell_id) {
+                throw std::invalid_argument{"The cell " + cell.cell_id + " is not the next cell of the scenario"};
+            }
+            cells.write<std::uint32_t>(cell_types.add(encode_string(cell.cell_type)));
+            cells.write<std::uint32_t>(delays.add(encode_string(cell.delay_id)));
+            cells.write<std::uint32_t>(configs.add(encode_config(*cell.config)));
+            cells.write<std::uint32_t>(states.add(encode_state(cell.initial_state)));
+            cells.write<double>(cell.initial_state.population);
+
+            std::vector<std::pair<std::string, vicinity const *>> edges;
+            for(auto const &edge : cell.neighborhood) {
+                if(!cell_ids.contains(edge.first)) {
+                    throw std::invalid_argument{"The cell " + cell.cell_id + " has an unknown neighbor: " + edge.first};
+                }
+                edges.emplace_back(edge.first, &edge.second);
+            }
+            std::sort(edges.begin(), edges.end(), [](auto const &a, auto const &b) { return a.first < b.first; });
+            cells.write<std::uint32_t>(edges.size());
+            for(auto const &edge : edges) {
+                cells.write<std::uint32_t>(cell_ids.index_of(edge.first));
+                cells.write<double>(edge.second->correlation);
+                cells.write<std::uint32_t>(profiles.add(encode_profile(*edge.second)));
+            }
+            ++num_cells;
+        }
+
+        void write(std::string const &file_path, std::uint64_t source_hash) const {
+            if(num_cells != cell_ids.size()) {
+                throw std::logic_error{"Only " + std::to_string(num_cells) + " of the " + std::to_string(cell_ids.size()) +
+                                       " cells of the scenario were added"};
+            }
+            encoder out;
+            out.bytes.append(magic, sizeof(magic));
+            out.write<std::uint32_t>(version);
+            out.write<std::uint32_t>(byte_order_mark);
+            out.write<std::uint64_t>(source_hash);
+            out.write<std::uint32_t>(fields.size());
+            for(auto const &field : fields) {
+                out.write_string(field);
+            }
+            out.write<std::uint32_t>(cell_ids.size());
+            for(auto const &cell_id : cell_ids.get_ids()) {
+                out.write_string(cell_id);
+            }
+            out.write<std::uint32_t>(order.size());
+            for(auto index : order) {
+                out.write<std::uint32_t>(index);
+            }
+            cell_types.write(out);
+            delays.write(out);
+            configs.write(out);
+            states.write(out);
+            profiles.write(out);
+            out.bytes.append(cells.bytes);
+
+            // Written to a temporary file first, so that a reader never sees a partly written scenario.
+            std::string temporary_path = file_path + ".tmp";
+            {
+                std::ofstream file{temporary_path, std::ios::binary | std::ios::trunc};
+                if(!file.is_open()) {
+                    throw std::runtime_error{"Unable to open the file: " + temporary_path};
+                }
+                file.write(out.bytes.data(), out.bytes.size());
+                if(!file) {
+                    throw std::runtime_error{"Unable to write the compiled scenario " + temporary_path};
+                }
+            }
+            if(std::rename(temporary_path.c_str(), file_path.c_str()) != 0) {
+                throw std::runtime_error{"Unable to rename " + temporary_path + " to " + file_path};
+            }
+        }
+
+    private:
+        std::vector<std::string> fields;
+        cell_id_table cell_ids;
+        std::vector<cell_index> order;
+        table cell_types, delays, configs, states, profiles;
+        encoder cells;
+        cell_index num_cells = 0;
+    };
+
+    // Writes the compiled form of a scenario; cells must be sorted by ID (as scenario_loader returns them).
+    inline void write(std::string const &file_path, scenario const &compiled, std::uint64_t source_hash) {
+        cell_id_table cell_ids;
+        for(auto const &cell : compiled.cells) {
+            cell_ids.intern(cell.cell_id);
+        }
+        writer out{compiled.fields, std::move(cell_ids), compiled.cell_order};
+        for(auto const &cell : compiled.cells) {
+            out.add(cell);
+        }
+        out.write(file_path, source_hash);
+    }
+
+    // A read-only memory mapping of a whole file.
+    class mapped_file {
+    public:
+        explicit mapped_file(std::string const &file_path) {
+            int descriptor = ::open(file_path.c_str(), O_RDONLY);
+            if(descriptor < 0) {
+                throw std::runtime_error{"Unable to open the file: " + file_path};
+            }
+            struct stat file_stat{};
+            if(::fstat(descriptor, &file_stat) != 0) {
+                ::close(descriptor);
+                throw std::runtime_error{"Unable to read the size of " + file_path};
+            }
+            size = file_stat.st_size;
+            if(size > 0) {
+                void *mapping = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+                if(mapping == MAP_FAILED) {
+                    ::close(descriptor);
+                    throw std::runtime_error{"Unable to map " + file_path + " into memory"};
+                }
+                data = static_cast<const char *>(mapping);
+            }
+            ::close(descriptor);
+        }
+
+        mapped_file(const mapped_file &) = delete;
+        mapped_file &operator=(const mapped_file &) = delete;
+
+        ~mapped_file() {
+            if(data) {
+                ::munmap(const_cast<char *>(data), size);
+            }
+        }
+
+        const char *begin() const {
+            return data;
+        }
+
+        const char *end() const {
+            return data + size;
+        }
+
+    private:
+        const char *data = nullptr;
+        std::size_t size = 0;
+    };
+
+    // Reads the header of a compiled scenario up to the hash of its source.
+    inline std::uint64_t read_header(decoder &in, std::string const &file_path) {
+        for(char expected : magic) {
+            if(in.read<char>() != expected) {
+                throw std::runtime_error{file_path + " is not a compiled scenario"};
+            }
+        }
+        if(in.read<std::uint32_t>() != version) {
+            throw std::runtime_error{"Unsupported compiled scenario version in " + file_path};
+        }
+        if(in.read<std::uint32_t>() != byte_order_mark) {
+            throw std::runtime_error{file_path + " was compiled on a machine with a different byte order"};
+        }
+        return in.read<std::uint64_t>();
+    }
+
+    inline std::vector<std::string> read_fields(decoder &in) {
+        std::vector<std::string> fields(in.read_count(sizeof(std::uint32_t)));
+        for(auto &field : fields) {
+            field = in.read_string();
+        }
+        return fields;
+    }
+
+    inline std::vector<std::string> read_cell_ids(decoder &in) {
+        std::vector<std::string> cell_ids(in.read_count(sizeof(std::uint32_t)));
+        for(auto &cell_id : cell_ids) {
+            cell_id = in.read_string();
+        }
+        return cell_ids;
+    }
+
+    inline std::vector<std::string> read_cell_order(decoder &in, std::vector<std::string> const &cell_ids) {
+        std::vector<std::string> cell_order(in.read_count(sizeof(std::uint32_t)));
+        for(auto &cell_id : cell_order) {
+            std::uint32_t index = in.read_index(cell_ids.size() + 1);
+            cell_id = index == cell_ids.size() ? "default" : cell_ids[index];
+        }
+        return cell_order;
+    }
+
+    inline scenario read(std::string const &file_path) {
+        mapped_file file{file_path};
+        decoder in{file.begin(), file.end()};
+        read_header(in, file_path);
+
+        scenario compiled;
+        compiled.fields = read_fields(in);
+        std::vector<std::string> cell_ids = read_cell_ids(in);
+        compiled.cell_order = read_cell_order(in, cell_ids);
+        std::vector<std::string> cell_types(in.read_count(sizeof(std::uint32_t)));
+        for(auto &cell_type : cell_types) {
+            cell_type = in.read_string();
+        }
+        std::vector<std::string> delays(in.read_count(sizeof(std::uint32_t)));
+        for(auto &delay : delays) {
+            delay = in.read_string();
+        }
+        // The configurations are a table already: the cells with the same one share it.
+        std::vector<std::shared_ptr<const simulation_config>> configs(in.read_count(min_config_size));
+        for(auto &config : configs) {
+            config = std::make_shared<const simulation_config>(decode_config(in));
+        }
+        std::vector<seaird> states(in.read_count(min_state_size));
+        for(auto &state : states) {
+            state = decode_state(in);
+        }
+        std::vector<vicinity> profiles(in.read_count(sizeof(std::uint32_t)));
+        for(auto &profile : profiles) {
+            profile.set_correction_factors(decode_profile(in));
+        }
+
+        compiled.cells.resize(cell_ids.size());
+        for(std::uint32_t i = 0; i < cell_ids.size(); ++i) {
+            cell_definition &cell = compiled.cells[i];
+            cell.cell_id = cell_ids[i];
+            cell.cell_type = cell_types[in.read_index(cell_types.size())];
+            cell.delay_id = delays[in.read_index(delays.size())];
+            cell.config = configs[in.read_index(configs.size())];
+            // The state is copied from the table, so that its buffers are not shared with the other cells.
+            seaird const &initial_state = states[in.read_index(states.size())];
+            cell.initial_state = initial_state;
+            cell.initial_state.compartments = std::make_shared<seaird::compartment_buffer>(*initial_state.compartments);
+            cell.initial_state.population = in.read<double>();
+            cell.initial_state.update_published_totals();
+
+            std::uint32_t num_edges = in.read_count(2 * sizeof(std::uint32_t) + sizeof(double));
+            for(std::uint32_t edge = 0; edge < num_edges; ++edge) {
+                std::string const &neighbor = cell_ids[in.read_index(cell_ids.size())];
+                double correlation = in.read<double>();
+                vicinity neighbor_vicinity = profiles[in.read_index(profiles.size())];
+                neighbor_vicinity.correlation = correlation;
+                cell.neighborhood.insert({neighbor, std::move(neighbor_vicinity)});
+            }
+        }
+        return compiled;
+    }
+
+    // Only reads the fields of a compiled scenario.
+    inline std::vector<std::string> read_fields(std::string const &file_path) {
+        mapped_file file{file_path};
+        decoder in{file.begin(), file.end()};
+        read_header(in, file_path);
+        return read_fields(in);
+    }
+
+    // Only reads the order of the cells of the file a compiled scenario was compiled from.
+    inline std::vector<std::string> read_cell_order(std::string const &file_path) {
+        mapped_file file{file_path};
+        decoder in{file.begin(), file.end()};
+        read_header(in, file_path);
+        read_fields(in);
+        std::vector<std::string> cell_ids = read_cell_ids(in);
+        return read_cell_order(in, cell_ids);
+    }
+
+    // The hash of the scenario file a compiled scenario was compiled from.
+    inline std::uint64_t read_source_hash(std::string const &file_path) {
+        mapped_file file{file_path};
+        decoder in{file.begin(), file.end()};
+        return read_header(in, file_path);
+    }
+
+    // Compiles a scenario file whose content has the given hash.
+    inline void compile(std::string const &scenario_path, std::string const &compiled_path, std::uint64_t source_hash,
+                        unsigned int num_threads = 1) {
+        thread_pool pool{num_threads};
+        scenario compiled;
+        compiled.fields = scenario_loader::read_fields(scenario_path);
+        compiled.cell_order = scenario_loader::read_cell_order(scenario_path);
+        compiled.cells = scenario_loader::load(scenario_path, pool);
+        write(compiled_path, compiled, source_hash);
+    }
+
+    inline void compile(std::string const &scenario_path, std::string const &compiled_path, unsigned int num_threads = 1) {
+        compile(scenario_path, compiled_path, content_hash(scenario_path), num_threads);
+    }
+
+    // Creates a directory and its missing parents, like mkdir -p (see main.cpp for why std::filesystem is not used).
+    inline void make_directories(std::string const &directory) {
+        for(std::size_t end = directory.find('/', 1); ; end = directory.find('/', end + 1)) {
+            std::string const parent = directory.substr(0, end);
+            if(!parent.empty() && ::mkdir(parent.c_str(), 0777) != 0 && errno != EEXIST) {
+                throw std::runtime_error{"Unable to create the directory " + parent + ": " + std::strerror(errno)};
+            }
+            if(end == std::string::npos) {
+                return;
+            }
+        }
+    }
+
+    // Returns the path of the compiled form of a scenario file in cache_directory, which is named after the hash of the
+    // content of the scenario file. The scenario is compiled first if it is not in the cache yet, or if its compiled
+    // form cannot be used (e.g. it was written by another version). The cache directory is created if needed.
+    inline std::string load_cached(std::string const &scenario_path, std::string const &cache_directory,
+                                   unsigned int num_threads = 1) {
+        make_directories(cache_directory);
+        std::uint64_t hash = content_hash(scenario_path);
+        std::ostringstream compiled_path;
+        compiled_path << cache_directory << "/scenario_" << std::hex << std::setw(16) << std::setfill('0') << hash << ".bin";
+
+        try {
+            if(read_source_hash(compiled_path.str()) == hash) {
+                return compiled_path.str();
+            }
+        } catch(std::runtime_error const &) {
+            // Not cached yet, or not readable by this version: compiled again below.
+        }
+        compile(scenario_path, compiled_path.str(), hash, num_threads);
+        return compiled_path.str();
+    }
+}
+
+#endif //PANDEMIC_HOYA_2002_COMPILED_SCENARIO_HPP
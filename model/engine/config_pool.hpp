@@ -0,0 +1,80 @@
+//
+// Interns the configurations of the cells, so that the cells with equal configurations share one immutable copy.
+//
+
+#ifndef PANDEMIC_HOYA_2002_CONFIG_POOL_HPP
+#define PANDEMIC_HOYA_2002_CONFIG_POOL_HPP
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include "../cells/simulation_config.hpp"
+
+// Nearly every cell of a scenario has the configuration of the "default" cell, and the rate tables of a configuration
+// (5 age groups of up to 14 phases for each of the 5 rates) are most of the memory of a cell besides its state. Cells
+// hold their configuration by a shared pointer to a const simulation_config; interning makes all the cells with equal
+// configurations point to the same one, whose tables then stay in cache from one cell to the next.
+//
+// Configurations are equal when all their values are; they are found by a hash of their values. A pool is not thread
+// safe: the loaders intern the configurations of a batch once it was converted.
+class config_pool {
+public:
+    using config_ptr = std::shared_ptr<const simulation_config>;
+
+    // Returns the configuration of the pool equal to config, adding config if there is none.
+    config_ptr intern(config_ptr config) {
+        std::vector<config_ptr> &candidates = configs[hash(*config)];
+        for(auto const &candidate : candidates) {
+            if(candidate == config || equal(*candidate, *config)) {
+                return candidate;
+            }
+        }
+        candidates.push_back(std::move(config));
+        ++num_configs;
+        return candidates.back();
+    }
+
+    config_ptr intern(simulation_config config) {
+        return intern(std::make_shared<const simulation_config>(std::move(config)));
+    }
+
+    // The number of distinct configurations.
+    std::size_t size() const {
+        return num_configs;
+    }
+
+    static bool equal(simulation_config const &a, simulation_config const &b) {
+        return a.prec_divider == b.prec_divider && a.virulence_rates == b.virulence_rates &&
+               a.incubation_rates == b.incubation_rates && a.recovery_rates == b.recovery_rates &&
+               a.mobility_rates == b.mobility_rates && a.fatality_rates == b.fatality_rates &&
+               a.asymptomatic_rates == b.asymptomatic_rates && a.SIIRS_model == b.SIIRS_model;
+    }
+
+    static std::size_t hash(simulation_config const &config) {
+        std::size_t seed = std::hash<int>{}(config.prec_divider);
+        auto combine = [&seed](std::size_t value) {
+            seed ^= value + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2);
+        };
+        for(auto const *rates : {&config.virulence_rates, &config.incubation_rates, &config.recovery_rates,
+                                 &config.mobility_rates, &config.fatality_rates}) {
+            combine(rates->size());
+            for(auto const &age_group_rates : *rates) {
+                combine(age_group_rates.size());
+                for(double rate : age_group_rates) {
+                    combine(std::hash<double>{}(rate));
+                }
+            }
+        }
+        combine(std::hash<double>{}(config.asymptomatic_rates));
+        combine(config.SIIRS_model);
+        return seed;
+    }
+
+private:
+    std::unordered_map<std::size_t, std::vector<config_ptr>> configs;
+    std::size_t num_configs = 0;
+};
+
+#endif //PANDEMIC_HOYA_2002_CONFIG_POOL_HPP
@@ -0,0 +1,284 @@
+//
+// Compressed sparse row (CSR) form of the neighborhoods, used to compute the new exposed of every cell.
+//
+
+#ifndef PANDEMIC_HOYA_2002_EXPOSURE_MATRIX_HPP
+#define PANDEMIC_HOYA_2002_EXPOSURE_MATRIX_HPP
+
+#include <algorithm>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+#include "../cells/geographical_cell.hpp"
+#include "cell_id_table.hpp"
+
+// The infection pressure on a cell is a weighted sum over its neighbors (see geographical_cell::new_exposed), where the
+// weights are the correlations of the vicinities, the mobility x virulence rates and the movement correction factors.
+// geographical_cell gathers these through string keyed lookups in its neighbors_state and neighbors_vicinity maps;
+// this matrix compiles the neighborhoods once when the scenario is loaded:
+//
+// * row i holds the edges of cell i, in the order of cells[i]->neighbors, in [row_offsets[i], row_offsets[i + 1]),
+// * every edge stores its column (the index of the neighbor), its correlation and its compiled correction factors;
+//   its hysteresis is the one at the same position in the hysteresis factors of the cell,
+// * the published totals and the disobedience of every cell are kept in flat arrays indexed by cell (and age group).
+//
+// compute_exposures then evaluates a row for all the age groups in a single pass over contiguous arrays. The terms are
+// accumulated in the same order as new_exposed, so the results are bit-identical to those of the Cadmium engine.
+//
+// The rows only depend on the neighborhoods, so one matrix can serve several simulations of the same cells (the lanes
+// of a parameter_sweep): each one has its own published_totals, and compute_lane_exposures evaluates a row for all of
+// them in one pass over its edges.
+template <typename T>
+class exposure_matrix {
+public:
+    using cell_model = geographical_cell<T>;
+
+    // The totals published by the cells of one simulation and the disobedience of its cells, indexed as the cells.
+    struct published_totals {
+        std::vector<double> infections;
+        std::vector<double> asymptomatic;
+        std::vector<double> disobedient;
+
+        // Appends the next cell, with the totals and the disobedience of its initial state. The disobedience of a cell
+        // never changes.
+        void add(seaird const &initial_state) {
+            infections.push_back(initial_state.published_infections);
+            asymptomatic.push_back(initial_state.published_asymptomatic);
+            disobedient.insert(disobedient.end(), initial_state.disobedient->begin(), initial_state.disobedient->end());
+        }
+
+        // Records the totals of a newly published state, read by the neighbors of the cell from the next step on.
+        void publish(cell_index cell, seaird const &published_state) {
+            infections[cell] = published_state.published_infections;
+            asymptomatic[cell] = published_state.published_asymptomatic;
+        }
+    };
+
+    // What compute_lane_exposures needs of the cell of a row in one simulation.
+    struct lane_row {
+        seaird const *current_state;
+        simulation_config const *config;
+        correction_factor_table const *correction_factors;  // Replaces those of every edge, if not null
+        published_totals const *totals;
+        seaird *res;                                        // The next state, whose hysteresis factors are updated
+        std::vector<double> *exposures;
+    };
+
+    void build(std::vector<std::unique_ptr<cell_model>> const &cells, cell_id_table const &cell_ids) {
+        num_age_segments = cells.empty() ? 0 : cells.front()->state.current_state.get_num_age_segments();
+
+        row_offsets.assign(1, 0);
+        columns.clear();
+        correlations.clear();
+        edge_correction_factors.clear();
+        self_edges.clear();
+        infected_phases.clear();
+        totals = {};
+
+        for(unsigned int i = 0; i < cells.size(); ++i) {
+            cell_model const &cell = *cells[i];
+            seaird const &initial_state = cell.state.current_state;
+
+            if(initial_state.get_num_age_segments() != num_age_segments) {
+                throw std::invalid_argument{"Every cell must have the same number of age groups (cell " + cell.cell_id + ")"};
+            }
+            totals.add(initial_state);
+            infected_phases.push_back(initial_state.get_num_infected_phases());
+
+            self_edges.push_back(row_offsets.back());
+            for(auto const &neighbor : cell.neighbors) {
+                if(neighbor == cell.cell_id) {
+                    self_edges.back() = columns.size();
+                }
+                columns.push_back(cell_ids.index_of(neighbor));
+                vicinity const &neighbor_vicinity = cell.state.neighbors_vicinity.at(neighbor);
+                correlations.push_back(neighbor_vicinity.correlation);
+                edge_correction_factors.push_back(&neighbor_vicinity.get_correction_table());
+            }
+            row_offsets.push_back(columns.size());
+
+            // The current cell must be part of its own neighborhood, as in geographical_cell::local_computation
+            if(std::find(cell.neighbors.begin(), cell.neighbors.end(), cell.cell_id) == cell.neighbors.end()) {
+                throw std::invalid_argument{"The cell " + cell.cell_id + " must be part of its own neighborhood"};
+            }
+        }
+
+        for(unsigned int i = 0; i < cells.size(); ++i) {
+            check_rates(cells, i, *cells[i]->config);
+        }
+
+        movement_factors.assign(columns.size(), 1.0f);
+    }
+
+    // new_exposed sums over the infected phases of each neighbor using the rates of the current cell, so a configuration
+    // of the cell of a row needs rates for as many phases as every neighbor has.
+    void check_rates(std::vector<std::unique_ptr<cell_model>> const &cells, cell_index row,
+                     simulation_config const &config) const {
+        for(unsigned int e = row_offsets[row]; e < row_offsets[row + 1]; ++e) {
+            for(auto const *rates : {&config.mobility_rates, &config.virulence_rates}) {
+                for(auto const &age_group_rates : *rates) {
+                    if(age_group_rates.size() < infected_phases[columns[e]]) {
+                        throw std::invalid_argument{"The cell " + cells[row]->cell_id + " has fewer mobility or virulence rates than infected phases of its neighbor " + cells[columns[e]]->cell_id};
+                    }
+                }
+            }
+        }
+    }
+
+    void publish(cell_index cell, seaird const &published_state) {
+        totals.publish(cell, published_state);
+    }
+
+    // The indices of the neighbors of the cell of a row, in the order of its neighbors.
+    std::pair<cell_index const *, cell_index const *> neighbors(cell_index row) const {
+        return {columns.data() + row_offsets[row], columns.data() + row_offsets[row + 1]};
+    }
+
+    // Computes the new exposed of every age group of the cell of the given row into exposures, updating the hysteresis
+    // factors of res (the next state of the cell). Rows can be computed concurrently; only the published totals are shared.
+    void compute_exposures(cell_index row, cell_model const &cell, seaird &res, std::vector<double> &exposures) {
+        unsigned int first_edge = row_offsets[row];
+        unsigned int last_edge = row_offsets[row + 1];
+
+        HOT_PATH_COUNT(cell.counters, neighbor_visits, (last_edge - first_edge) * num_age_segments);
+
+        seaird::hysteresis_edges &hysteresis_factors = res.hysteresis_factors();
+        for(unsigned int e = first_edge; e < last_edge; ++e) {
+            movement_factors[e] = cell.movement_correction_factor(*edge_correction_factors[e], totals.infections[columns[e]],
+                                                                  hysteresis_factors[e - first_edge]);
+        }
+        float self_movement_factor = movement_factors[self_edges[row]];
+
+        seaird const &cstate = cell.state.current_state;
+        exposures.resize(num_age_segments);
+        for(unsigned int age_segment_index = 0; age_segment_index < num_age_segments; ++age_segment_index) {
+            double susceptible = cstate.susceptible()[age_segment_index];
+            double const *mobility_rates = cell.config->mobility_rates[age_segment_index].data();
+            double const *virulence_rates = cell.config->virulence_rates[age_segment_index].data();
+
+            double self_disobedient = totals.disobedient[row * num_age_segments + age_segment_index];
+            double current_cell_correction_factor = self_disobedient + (1 - self_disobedient) * self_movement_factor;
+
+            double expos_i = 0;
+            double expos_a = 0;
+            for(unsigned int e = first_edge; e < last_edge; ++e) {
+                cell_index column = columns[e];
+                double neighbor_disobedient = totals.disobedient[column * num_age_segments + age_segment_index];
+                double neighbor_correction = std::min(current_cell_correction_factor,
+                                                      neighbor_disobedient + (1 - neighbor_disobedient) * movement_factors[e]);
+                double correlation = correlations[e];
+                double neighbor_infections = totals.infections[column];
+                double neighbor_asymptomatic = totals.asymptomatic[column];
+
+                for(unsigned int i = 0; i < infected_phases[column]; ++i) {
+                    expos_i += correlation * mobility_rates[i] * virulence_rates[i] * susceptible * neighbor_infections * neighbor_correction;
+                    expos_a += correlation * mobility_rates[i] * virulence_rates[i] * susceptible * neighbor_asymptomatic;
+                }
+            }
+            exposures[age_segment_index] = std::min(susceptible, expos_i + expos_a);
+        }
+    }
+
+    // compute_exposures for the cell of a row in several simulations at once: every edge is read once for all of them.
+    // Every lane gets the exposures that compute_exposures computes with its state, configuration and totals, as the
+    // terms of each lane and age group are accumulated in the same order. cell only evaluates the movement correction
+    // factors; the lanes may compute the same row concurrently as long as they do not share a next state.
+    void compute_lane_exposures(cell_index row, cell_model const &cell, std::vector<lane_row> const &lanes) const {
+        unsigned int first_edge = row_offsets[row];
+        unsigned int last_edge = row_offsets[row + 1];
+        unsigned int num_edges = last_edge - first_edge;
+
+        HOT_PATH_COUNT(cell.counters, neighbor_visits, num_edges * num_age_segments * lanes.size());
+
+        // The movement correction factor of every edge in every lane, lane by lane.
+        std::vector<float> lane_movement_factors(lanes.size() * num_edges);
+        for(unsigned int l = 0; l < lanes.size(); ++l) {
+            lane_row const &lane = lanes[l];
+            seaird::hysteresis_edges &hysteresis_factors = lane.res->hysteresis_factors();
+            for(unsigned int e = first_edge; e < last_edge; ++e) {
+                correction_factor_table const &factors = lane.correction_factors ? *lane.correction_factors
+                                                                                 : *edge_correction_factors[e];
+                lane_movement_factors[l * num_edges + e - first_edge] =
+                        cell.movement_correction_factor(factors, lane.totals->infections[columns[e]],
+                                                        hysteresis_factors[e - first_edge]);
+            }
+        }
+
+        // The terms of every age group of every lane, lane by lane.
+        struct age_group_terms {
+            double susceptible;
+            double const *mobility_rates;
+            double const *virulence_rates;
+            double current_cell_correction_factor;
+            double expos_i;
+            double expos_a;
+        };
+        std::vector<age_group_terms> terms;
+        terms.reserve(lanes.size() * num_age_segments);
+        for(unsigned int l = 0; l < lanes.size(); ++l) {
+            lane_row const &lane = lanes[l];
+            float self_movement_factor = lane_movement_factors[l * num_edges + self_edges[row] - first_edge];
+            for(unsigned int age_segment_index = 0; age_segment_index < num_age_segments; ++age_segment_index) {
+                double self_disobedient = lane.totals->disobedient[row * num_age_segments + age_segment_index];
+                terms.push_back({lane.current_state->susceptible()[age_segment_index],
+                                 lane.config->mobility_rates[age_segment_index].data(),
+                                 lane.config->virulence_rates[age_segment_index].data(),
+                                 self_disobedient + (1 - self_disobedient) * self_movement_factor, 0, 0});
+            }
+        }
+
+        for(unsigned int e = first_edge; e < last_edge; ++e) {
+            cell_index column = columns[e];
+            double correlation = correlations[e];
+            unsigned int num_infected_phases = infected_phases[column];
+            for(unsigned int l = 0; l < lanes.size(); ++l) {
+                published_totals const &lane_totals = *lanes[l].totals;
+                float movement_factor = lane_movement_factors[l * num_edges + e - first_edge];
+                double neighbor_infections = lane_totals.infections[column];
+                double neighbor_asymptomatic = lane_totals.asymptomatic[column];
+                for(unsigned int age_segment_index = 0; age_segment_index < num_age_segments; ++age_segment_index) {
+                    age_group_terms &term = terms[l * num_age_segments + age_segment_index];
+                    double neighbor_disobedient = lane_totals.disobedient[column * num_age_segments + age_segment_index];
+                    double neighbor_correction = std::min(term.current_cell_correction_factor,
+                                                          neighbor_disobedient + (1 - neighbor_disobedient) * movement_factor);
+                    for(unsigned int i = 0; i < num_infected_phases; ++i) {
+                        term.expos_i += correlation * term.mobility_rates[i] * term.virulence_rates[i] * term.susceptible * neighbor_infections * neighbor_correction;
+                        term.expos_a += correlation * term.mobility_rates[i] * term.virulence_rates[i] * term.susceptible * neighbor_asymptomatic;
+                    }
+                }
+            }
+        }
+
+        for(unsigned int l = 0; l < lanes.size(); ++l) {
+            lanes[l].exposures->resize(num_age_segments);
+            for(unsigned int age_segment_index = 0; age_segment_index < num_age_segments; ++age_segment_index) {
+                age_group_terms const &term = terms[l * num_age_segments + age_segment_index];
+                (*lanes[l].exposures)[age_segment_index] = std::min(term.susceptible, term.expos_i + term.expos_a);
+            }
+        }
+    }
+
+    unsigned int get_num_age_segments() const {
+        return num_age_segments;
+    }
+
+private:
+    unsigned int num_age_segments = 0;
+
+    std::vector<unsigned int> row_offsets;
+    std::vector<cell_index> columns;
+    std::vector<double> correlations;
+    std::vector<correction_factor_table const *> edge_correction_factors;
+    std::vector<unsigned int> self_edges;
+
+    // Scratch space for the movement correction factor of every edge; each row is only written while it is computed.
+    std::vector<float> movement_factors;
+
+    std::vector<unsigned int> infected_phases;
+    // Those of the simulation of the runner that built the matrix.
+    published_totals totals;
+};
+
+#endif //PANDEMIC_HOYA_2002_EXPOSURE_MATRIX_HPP
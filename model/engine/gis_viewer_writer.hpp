@@ -0,0 +1,158 @@
+//
+// Writes the messages.log and structure.json files of the GIS Web Viewer V2 while the simulation runs.
+//
+
+#ifndef PANDEMIC_HOYA_2002_GIS_VIEWER_WRITER_HPP
+#define PANDEMIC_HOYA_2002_GIS_VIEWER_WRITER_HPP
+
+#include <algorithm>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "../cells/seaird.hpp"
+#include "cell_id_table.hpp"
+#include "compiled_scenario.hpp"
+#include "log_sink.hpp"
+#include "scenario_loader.hpp"
+
+// Produces what the message log parser (Scripts/Msg_Log_Parser) produces from the message log and the scenario:
+//
+// * structure.json: one atomic node per cell of the "cells" section of the scenario, "default" included, in the order
+//   of the scenario file (see read_nodes). Every node has the names of the fields of the scenario ("fields", e.g.
+//   ["Population", "Susceptible", ...]) as its template,
+// * messages.log: every time step is a line with the time, followed by one line per published state: the index of the
+//   cell's node in structure.json and the values of the fields, separated by commas.
+//
+// The values of a line are taken by name, so the fields of the scenario may list the logged values in any order and
+// leave some of them out (see field_index for the names known).
+template <typename T>
+class gis_viewer_writer : public log_sink<T> {
+public:
+    // fields are the names of the "fields" section of the scenario (see read_fields), and nodes the names of its cells in
+    // the order of the scenario file (see read_nodes).
+    gis_viewer_writer(std::string const &directory, std::vector<std::string> fields, std::vector<std::string> nodes) :
+            directory{directory}, fields{std::move(fields)}, nodes{std::move(nodes)}, buffer(1 << 20) {
+        for(auto const &field : this->fields) {
+            field_indices.push_back(field_index(field));
+        }
+        messages.rdbuf()->pubsetbuf(buffer.data(), buffer.size());
+        messages.open(directory + "/messages.log", std::ios::trunc);
+        if(!messages.is_open()) {
+            throw std::runtime_error{"Unable to open the file: " + directory + "/messages.log"};
+        }
+    }
+
+    // Reads the "fields" section of a scenario file, added by the scripts of Scripts/Input_Generator from fields.json,
+    // or the fields of a compiled scenario.
+    static std::vector<std::string> read_fields(std::string const &scenario_path) {
+        std::vector<std::string> fields = compiled_scenario::is_compiled(scenario_path)
+                                          ? compiled_scenario::read_fields(scenario_path)
+                                          : scenario_loader::read_fields(scenario_path);
+        if(fields.empty()) {
+            throw std::invalid_argument{"The scenario " + scenario_path + " has no fields section for the GIS viewer"};
+        }
+        return fields;
+    }
+
+    // Reads the IDs of the cells of a scenario in the order of the scenario file, "default" included (its position in a
+    // compiled scenario is that of the file it was compiled from). The parser names the nodes in this order.
+    static std::vector<std::string> read_nodes(std::string const &scenario_path) {
+        return compiled_scenario::is_compiled(scenario_path) ? compiled_scenario::read_cell_order(scenario_path)
+                                                             : scenario_loader::read_cell_order(scenario_path);
+    }
+
+    // Index in seaird::log_fields of the value shown under a field name of the viewer.
+    static unsigned int field_index(std::string const &field) {
+        static const char *const names[seaird::num_log_fields] = {
+                "Population", "Susceptible", "Exposed", "Infected", "Recovered", "New Exposed", "New Infected",
+                "New Recovered", "Deaths", "New Asymptomatic", "Asymptomatic"
+        };
+        for(unsigned int i = 0; i < seaird::num_log_fields; ++i) {
+            if(field == names[i]) {
+                return i;
+            }
+        }
+        throw std::invalid_argument{"Unknown field for the GIS viewer: " + field};
+    }
+
+    void start(cell_id_table const &cell_ids) override {
+        // The runner logs the cells by their index, which is not their node.
+        node_indices.assign(cell_ids.size(), no_node);
+        for(unsigned int node = 0; node < nodes.size(); ++node) {
+            if(nodes[node] == "default") {
+                continue;
+            } else if(!cell_ids.contains(nodes[node]) || node_indices[cell_ids.index_of(nodes[node])] != no_node) {
+                throw std::invalid_argument{"The nodes of the GIS viewer do not match the cells: " + nodes[node]};
+            }
+            node_indices[cell_ids.index_of(nodes[node])] = node;
+        }
+        if(std::find(node_indices.begin(), node_indices.end(), no_node) != node_indices.end()) {
+            throw std::invalid_argument{"The nodes of the GIS viewer do not match the cells: some cells have no node"};
+        }
+
+        std::ofstream structure{directory + "/structure.json", std::ios::trunc};
+        if(!structure.is_open()) {
+            throw std::runtime_error{"Unable to open the file: " + directory + "/structure.json"};
+        }
+
+        // The template is the JSON array of the field names, stored as a string.
+        std::string node_template = nlohmann::json(nlohmann::json(fields).dump()).dump();
+        structure << R"({"info":{"simulator":"Cadmium","name":"pandemic_messages","type":"Irregular Cell-DEVS"},"nodes":[)";
+        for(unsigned int node = 0; node < nodes.size(); ++node) {
+            structure << (node == 0 ? "" : ",");
+            write_node(structure, nodes[node], node_template);
+        }
+        structure << "]}";
+        if(!structure) {
+            throw std::runtime_error{"Unable to write " + directory + "/structure.json"};
+        }
+    }
+
+    void time_step(T time) override {
+        // The start of the simulation and its first time step have the same time; they are one frame in the viewer.
+        if(any_time && time == current_time) {
+            return;
+        }
+        messages << time << "\n";
+        any_time = true;
+        current_time = time;
+    }
+
+    void message(T time, cell_index cell, seaird::log_values const &published_state) override {
+        messages << node_indices[cell];
+        for(unsigned int index : field_indices) {
+            messages << "," << published_state[index];
+        }
+        messages << "\n";
+    }
+
+    void finish() override {
+        messages.flush();
+        if(!messages) {
+            throw std::runtime_error{"Unable to write " + directory + "/messages.log"};
+        }
+    }
+
+private:
+    std::string directory;
+    static constexpr unsigned int no_node = std::numeric_limits<unsigned int>::max();
+
+    std::vector<std::string> fields;
+    std::vector<std::string> nodes;
+    std::vector<unsigned int> node_indices;     // The node of every cell index
+    std::vector<unsigned int> field_indices;
+    std::vector<char> buffer;
+    std::ofstream messages;
+
+    T current_time{};
+    bool any_time = false;
+
+    static void write_node(std::ostream &os, std::string const &name, std::string const &node_template) {
+        os << R"({"name":)" << nlohmann::json(name).dump() << R"(,"type":"atomic","template":)" << node_template << "}";
+    }
+};
+
+#endif //PANDEMIC_HOYA_2002_GIS_VIEWER_WRITER_HPP
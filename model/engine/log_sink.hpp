@@ -0,0 +1,143 @@
+//
+// Destinations of the messages and states logged by the synchronous runner.
+//
+
+#ifndef PANDEMIC_HOYA_2002_LOG_SINK_HPP
+#define PANDEMIC_HOYA_2002_LOG_SINK_HPP
+
+#include <ostream>
+#include <string>
+#include <vector>
+#include "../cells/seaird.hpp"
+#include "cell_id_table.hpp"
+
+// The runner reports what it logs through these calls, in this order:
+//
+// * start once, with the IDs of the cells,
+// * resume for every cell if the run was resumed from a checkpoint, with the state the cell published last,
+// * time_step at the start of the simulation and at every time step,
+// * message for every state published at a time step, then state for every cell that published or received a state,
+// * finish at the end of every run_until, so that what was logged so far reaches its destination.
+//
+// At the start of the simulation time_step is followed by the initial state of every cell and no message. States are
+// passed as the values they are logged with (seaird::log_fields), computed once by the runner for all the sinks.
+template <typename T>
+class log_sink {
+public:
+    virtual ~log_sink() = default;
+
+    virtual void start(cell_id_table const &cell_ids) {}
+
+    virtual void resume(T time, cell_index cell, seaird::log_values const &published_state) {}
+
+    virtual void time_step(T time) {}
+
+    virtual void message(T time, cell_index cell, seaird::log_values const &published_state) {}
+
+    virtual void state(T time, cell_index cell, seaird::log_values const &current_state) {}
+
+    virtual void finish() {}
+};
+
+// Forwards every call to several sinks, in the order in which they were added.
+template <typename T>
+class log_sink_group : public log_sink<T> {
+public:
+    void add(log_sink<T> &sink) {
+        sinks.push_back(&sink);
+    }
+
+    void start(cell_id_table const &cell_ids) override {
+        for(auto sink : sinks) {
+            sink->start(cell_ids);
+        }
+    }
+
+    void resume(T time, cell_index cell, seaird::log_values const &published_state) override {
+        for(auto sink : sinks) {
+            sink->resume(time, cell, published_state);
+        }
+    }
+
+    void time_step(T time) override {
+        for(auto sink : sinks) {
+            sink->time_step(time);
+        }
+    }
+
+    void message(T time, cell_index cell, seaird::log_values const &published_state) override {
+        for(auto sink : sinks) {
+            sink->message(time, cell, published_state);
+        }
+    }
+
+    void state(T time, cell_index cell, seaird::log_values const &current_state) override {
+        for(auto sink : sinks) {
+            sink->state(time, cell, current_state);
+        }
+    }
+
+    void finish() override {
+        for(auto sink : sinks) {
+            sink->finish();
+        }
+    }
+
+private:
+    std::vector<log_sink<T> *> sinks;
+};
+
+// The text logs of main.cpp, in the format of Cadmium's message and state loggers.
+template <typename T>
+class text_log_sink : public log_sink<T> {
+public:
+    text_log_sink(std::ostream &messages_log, std::ostream &state_log) : messages_log{messages_log}, state_log{state_log} {}
+
+    // Same as the IDs Cadmium gives to the atomic models of a geographical_coupled with an empty ID.
+    static std::string model_name(std::string const &cell_id) {
+        return "_" + cell_id;
+    }
+
+    static void write_time(std::ostream &os, T time) {
+        os << time << "\n";
+    }
+
+    static void write_message(std::ostream &os, std::string const &cell_id, seaird::log_values const &fields) {
+        os << "[cadmium::celldevs::cell_ports_def<std::string, seaird>::cell_out: {" << cell_id << " ; ";
+        print_log_fields(os, fields) << "}] generated by model " << model_name(cell_id) << "\n";
+    }
+
+    static void write_state(std::ostream &os, std::string const &cell_id, seaird::log_values const &fields) {
+        os << "State for model " << model_name(cell_id) << " is ";
+        print_log_fields(os, fields) << "\n";
+    }
+
+    void start(cell_id_table const &ids) override {
+        cell_ids = &ids;
+    }
+
+    void time_step(T time) override {
+        write_time(messages_log, time);
+        write_time(state_log, time);
+    }
+
+    void message(T time, cell_index cell, seaird::log_values const &published_state) override {
+        write_message(messages_log, cell_ids->id(cell), published_state);
+    }
+
+    void state(T time, cell_index cell, seaird::log_values const &current_state) override {
+        write_state(state_log, cell_ids->id(cell), current_state);
+    }
+
+    void finish() override {
+        messages_log.flush();
+        state_log.flush();
+    }
+
+private:
+    std::ostream &messages_log;
+    std::ostream &state_log;
+    cell_id_table const *cell_ids = nullptr;
+};
+
+#endif //PANDEMIC_HOYA_2002_LOG_SINK_HPP
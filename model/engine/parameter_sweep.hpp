@@ -0,0 +1,503 @@
+//
+// Runs variants of one scenario, which only differ in some of their parameters, together in one process.
+//
+
+#ifndef PANDEMIC_HOYA_2002_PARAMETER_SWEEP_HPP
+#define PANDEMIC_HOYA_2002_PARAMETER_SWEEP_HPP
+
+#include <algorithm>
+#include <fstream>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <typeinfo>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "../cells/simulation_config.hpp"
+#include "../cells/vicinity.hpp"
+#include "cell_id_table.hpp"
+#include "checkpoint.hpp"
+#include "config_pool.hpp"
+#include "exposure_matrix.hpp"
+#include "log_sink.hpp"
+#include "scenario_loader.hpp"
+#include "synchronous_runner.hpp"
+#include "thread_pool.hpp"
+
+// A sweep specification is a JSON file listing the variants of a scenario:
+//
+//     {"variants": [
+//         {"name": "baseline"},
+//         {"name": "virulence_high", "config": {"virulence_rates": [[...], ...]}},
+//         {"name": "disobedient_20", "disobedient": [0.2, 0.2, 0.2, 0.2, 0.2]},
+//         {"name": "strict", "infection_correction_factors": {"0.1": [0.4, 0.05]}}
+//     ]}
+//
+// and every variant applies its entries to every cell of the scenario:
+//
+// * "config" replaces the given members of the configuration ("virulence_rates", "precision", ...),
+// * "disobedient" replaces the disobedient proportions of the initial state,
+// * "infection_correction_factors" replaces the correction factors of every vicinity (the correlations are kept).
+//
+// The scenario is loaded once, and its cells (their IDs, neighborhoods and configurations) and the exposure_matrix of
+// their neighborhoods exist once for the whole sweep. Every variant is a lane, which only holds what differs between
+// the variants: the states of the cells (with the hysteresis of their edges) and the states they published, the
+// published totals and the disobedience of the cells, the flags of the cells publishing and receiving a state, the
+// configurations if the variant changes them (one per distinct configuration of the scenario) and the correction
+// factors if the variant replaces them.
+//
+// The lanes advance together, one time step at a time. Within a step the cells are shared between the threads, and
+// the thread of a cell reads the edges of the cell once for all the lanes in which it receives a state (see
+// exposure_matrix::compute_lane_exposures), then computes its next state in each of them. Each lane logs to its own
+// sink; its logs are those of the variant run alone by a synchronous_runner.
+//
+// A sweep can also fork a simulation: the lanes are then branches that start from the state of a baseline runner
+// (e.g. the scenario run up to the day of an intervention) instead of the initial states, so the common prefix is
+// simulated once. The branches are lanes like any other: they share the cells and the exposure matrix of the sweep,
+// built once from the definitions, and each one has its own arrays of states, flags and totals. The states in these
+// arrays start as copies of the baseline's states that share their compartment and hysteresis buffers (see seaird),
+// so a branch only has buffers of its own for the cells whose state it changed. The baseline runner is not shared:
+// it has its own cells and matrix, as long as the caller keeps it.
+template <typename T>
+class parameter_sweep {
+public:
+    using cell_model = geographical_cell<T>;
+
+    struct variant {
+        std::string name;
+        nlohmann::json config = nlohmann::json::object();       // Members of simulation_config to replace
+        std::optional<std::vector<double>> disobedient;
+        std::optional<nlohmann::json> infection_correction_factors;
+    };
+
+    // Reads a sweep specification; the names of the variants must be unique, as they label their outputs.
+    static std::vector<variant> read_variants(std::string const &file_path) {
+        std::ifstream file{file_path};
+        if(!file.is_open()) {
+            throw std::runtime_error{"Unable to open the file: " + file_path};
+        }
+        nlohmann::json specification;
+        file >> specification;
+
+        std::vector<variant> variants;
+        for(auto const &entry : specification.at("variants")) {
+            variant current;
+            entry.at("name").get_to(current.name);
+            for(auto const &member : entry.items()) {
+                if(member.key() == "config") {
+                    current.config = member.value();
+                } else if(member.key() == "disobedient") {
+                    current.disobedient = member.value().get<std::vector<double>>();
+                } else if(member.key() == "infection_correction_factors") {
+                    current.infection_correction_factors = member.value();
+                } else if(member.key() != "name") {
+                    throw std::invalid_argument{"Unknown entry of the variant " + current.name + ": " + member.key()};
+                }
+            }
+            for(auto const &other : variants) {
+                if(other.name == current.name) {
+                    throw std::invalid_argument{"The variant " + current.name + " is defined more than once"};
+                }
+            }
+            variants.push_back(std::move(current));
+        }
+        if(variants.empty()) {
+            throw std::invalid_argument{"The sweep " + file_path + " has no variants"};
+        }
+        return variants;
+    }
+
+    // Builds the cells of a scenario (as scenario_loader or compiled_scenario::read return them) once, and a lane for
+    // every variant. The cells of a step are evaluated by num_threads threads.
+    parameter_sweep(std::vector<cell_definition> const &definitions, std::vector<variant> variants,
+                    unsigned int num_threads = 1) : pool{num_threads} {
+        add_cells(definitions);
+        for(auto const &current : variants) {
+            lanes.push_back(make_lane(current, nullptr));
+        }
+    }
+
+    // Forks the current state of baseline, a runner of the same cells, into a branch per variant. The variants apply to
+    // the branches as to the lanes of a sweep, the disobedient proportions to the states of the baseline too. The
+    // baseline may go on or be destroyed afterwards.
+    parameter_sweep(std::vector<cell_definition> const &definitions, std::vector<variant> variants,
+                    synchronous_runner<T> const &baseline, unsigned int num_threads = 1) : pool{num_threads} {
+        add_cells(definitions);
+        if(baseline.get_cell_ids().get_ids() != cell_ids.get_ids()) {
+            throw std::invalid_argument{"The baseline of a fork must have the cells of the scenario"};
+        }
+        // Kept for the lifetime of the branches: as long as the fork point holds the shared buffers, every branch
+        // copies a buffer before writing it, so no branch writes a buffer that another one still reads.
+        fork_point = baseline.take_snapshot();
+        for(cell_index i = 0; i < cells.size(); ++i) {
+            try {
+                checkpoint::check_state(fork_point.states[i], cells[i]->neighbors.size(), cells[i]->cell_id);
+            } catch(std::runtime_error const &error) {
+                throw std::invalid_argument{std::string{"The baseline of a fork does not match the scenario: "} +
+                                            error.what()};
+            }
+        }
+        for(auto const &current : variants) {
+            lanes.push_back(make_lane(current, &fork_point));
+        }
+    }
+
+    std::vector<std::string> get_names() const {
+        std::vector<std::string> names;
+        for(auto const &current : lanes) {
+            names.push_back(current.name);
+        }
+        return names;
+    }
+
+    // The cells of the scenario, shared by the lanes, with the initial states of the scenario.
+    std::vector<std::unique_ptr<cell_model>> const &get_cells() const {
+        return cells;
+    }
+
+    cell_id_table const &get_cell_ids() const {
+        return cell_ids;
+    }
+
+    // Runs every time step strictly before end_time in every lane; sinks holds the sink of every lane, in the order
+    // of the variants. A lane stops when none of its cells publishes a state, as a runner alone does.
+    void run_until(T end_time, std::vector<log_sink<T> *> const &sinks) {
+        if(sinks.size() != lanes.size()) {
+            throw std::invalid_argument{"A parameter sweep needs one sink per variant"};
+        }
+        for(unsigned int l = 0; l < lanes.size(); ++l) {
+            start(lanes[l], *sinks[l]);
+        }
+
+        std::vector<lane *> active;
+        while(true) {
+            active.clear();
+            for(auto &current : lanes) {
+                if(current.simulation_time < end_time &&
+                   std::find(current.published.begin(), current.published.end(), true) != current.published.end()) {
+                    active.push_back(&current);
+                }
+            }
+            if(active.empty()) {
+                break;
+            }
+
+            for(auto *current : active) {
+                begin_step(*current, *sinks[current - lanes.data()]);
+            }
+            pool.parallel_for(cells.size(), [&](cell_index i) { step_cell(i, active); });
+            for(auto *current : active) {
+                end_step(*current, *sinks[current - lanes.data()]);
+            }
+        }
+
+        for(auto *sink : sinks) {
+            sink->finish();
+        }
+    }
+
+private:
+    // What a variant has of its own; the cells of the scenario are shared by all the lanes.
+    struct lane {
+        std::string name;
+        std::vector<seaird> states;
+        // As in synchronous_runner: the states published at the current step, and the flags of the cells publishing
+        // their state at the current and at the next step and receiving one at the current step.
+        std::vector<seaird> published_states;
+        std::vector<char> published;
+        std::vector<char> next_published;
+        std::vector<char> received;
+        typename exposure_matrix<T>::published_totals totals;
+        // The configuration of every cell, if the variant changes them; otherwise the cells keep theirs.
+        std::vector<std::shared_ptr<const simulation_config>> configs;
+        std::optional<correction_factor_table> correction_factors;
+        T simulation_time = 0;
+        bool sink_started = false;
+        bool initialized = false;
+        bool resumed = false;
+    };
+
+    std::vector<std::unique_ptr<cell_model>> cells;
+    cell_id_table cell_ids;
+    config_pool configs;
+    exposure_matrix<T> exposures;
+    thread_pool pool;
+    std::vector<lane> lanes;
+    checkpoint::snapshot<T> fork_point;
+
+    // The cells are built as synchronous_runner::add_cell builds them.
+    void add_cell(cell_definition const &definition) {
+        if(definition.cell_type != "zhong") {
+            throw std::bad_typeid();
+        }
+        if(cell_ids.contains(definition.cell_id)) {
+            throw std::invalid_argument{"The cell " + definition.cell_id + " is defined more than once"};
+        }
+        auto new_cell = std::make_unique<cell_model>(definition.cell_id, definition.neighborhood, definition.initial_state,
+                                                     definition.delay_id, configs.intern(definition.config));
+        if(new_cell->output_delay(new_cell->state.current_state) != 1) {
+            throw std::invalid_argument{"A parameter sweep requires every cell to have an output delay of 1"};
+        }
+        cell_ids.intern(definition.cell_id);
+        cells.push_back(std::move(new_cell));
+    }
+
+    // Builds the cells and the exposure matrix once, as synchronous_runner::couple_cells does.
+    void add_cells(std::vector<cell_definition> const &definitions) {
+        for(auto const &definition : definitions) {
+            add_cell(definition);
+        }
+        for(auto const &cell : cells) {
+            for(auto const &neighbor : cell->neighbors) {
+                if(!cell_ids.contains(neighbor)) {
+                    throw std::invalid_argument{"The cell " + cell->cell_id + " has an unknown neighbor: " + neighbor};
+                }
+            }
+        }
+        exposures.build(cells, cell_ids);
+    }
+
+    // A lane starts from the initial states of the cells, as a runner does after couple_cells, or from the states of
+    // a fork point, as a runner does after restoring it.
+    lane make_lane(variant const &current, checkpoint::snapshot<T> const *start) {
+        lane result;
+        result.name = current.name;
+
+        std::shared_ptr<const std::vector<double>> disobedient;
+        if(current.disobedient) {
+            if(current.disobedient->size() != exposures.get_num_age_segments()) {
+                throw std::invalid_argument{"The variant " + current.name + " has " +
+                                            std::to_string(current.disobedient->size()) + " disobedient proportions;" +
+                                            " the cells have " + std::to_string(exposures.get_num_age_segments()) +
+                                            " age groups"};
+            }
+            disobedient = std::make_shared<const std::vector<double>>(*current.disobedient);
+        }
+        if(current.infection_correction_factors) {
+            result.correction_factors = nlohmann::json{{"correlation", 1.0},
+                                                       {"infection_correction_factors", *current.infection_correction_factors}}
+                                        .get<vicinity>().get_correction_table();
+        }
+
+        // Every distinct configuration of the scenario is changed once, so the lane shares them as the scenario does.
+        std::unordered_map<simulation_config const *, std::shared_ptr<const simulation_config>> changed_configs;
+        for(cell_index i = 0; i < cells.size(); ++i) {
+            if(!current.config.empty()) {
+                auto &changed = changed_configs[cells[i]->config.get()];
+                if(!changed) {
+                    changed = configs.intern(patch_config(*cells[i]->config, current.config, current.name));
+                }
+                check_config(*changed, cells[i]->state.current_state, cells[i]->cell_id, current.name);
+                exposures.check_rates(cells, i, *changed);
+                result.configs.push_back(changed);
+            }
+            result.states.push_back(start ? start->states[i] : cells[i]->state.current_state);
+            if(disobedient) {
+                result.states.back().disobedient = disobedient;
+            }
+            result.totals.add(result.states.back());
+        }
+
+        result.published_states = result.states;
+        if(start) {
+            result.published = start->published;
+            result.simulation_time = start->time;
+            result.initialized = true;
+            result.resumed = true;
+        } else {
+            result.published.assign(cells.size(), true);
+        }
+        result.next_published.assign(cells.size(), false);
+        result.received.assign(cells.size(), false);
+        return result;
+    }
+
+    // The steps of a lane are those of synchronous_runner (start, begin_step, step_cell and end_step), over the
+    // arrays of the lane.
+    void start(lane &current, log_sink<T> &sink) {
+        if(!current.sink_started) {
+            sink.start(cell_ids);
+            current.sink_started = true;
+            if(current.resumed) {
+                for(cell_index i = 0; i < cells.size(); ++i) {
+                    sink.resume(current.simulation_time, i, current.published_states[i].log_fields());
+                }
+            }
+        }
+        if(!current.initialized) {
+            sink.time_step(current.simulation_time);
+            for(cell_index i = 0; i < cells.size(); ++i) {
+                sink.state(current.simulation_time, i, current.states[i].log_fields());
+            }
+            current.initialized = true;
+        }
+    }
+
+    void begin_step(lane &current, log_sink<T> &sink) {
+        sink.time_step(current.simulation_time);
+        for(cell_index i = 0; i < cells.size(); ++i) {
+            if(current.published[i]) {
+                sink.message(current.simulation_time, i, current.published_states[i].log_fields());
+            }
+        }
+    }
+
+    // Computes the next state of a cell in every active lane in which one of its neighbors published its state at this
+    // step. Only writes the state of the cell in the lanes (and the shared cell, see lane_next_state), so the cells of
+    // a step can be computed concurrently.
+    void step_cell(cell_index i, std::vector<lane *> const &active) {
+        auto neighbors = exposures.neighbors(i);
+        std::vector<lane *> receiving;
+        for(auto *current : active) {
+            if(std::any_of(neighbors.first, neighbors.second, [current](cell_index n) { return current->published[n]; })) {
+                current->received[i] = true;
+                receiving.push_back(current);
+            }
+        }
+        if(receiving.empty()) {
+            return;
+        }
+
+        cell_model &cell = *cells[i];
+        std::vector<seaird> new_states;
+        std::vector<std::vector<double>> cell_exposures(receiving.size());
+        std::vector<typename exposure_matrix<T>::lane_row> rows;
+        new_states.reserve(receiving.size());
+        for(unsigned int l = 0; l < receiving.size(); ++l) {
+            lane &current = *receiving[l];
+            new_states.push_back(current.states[i]);
+            rows.push_back({&current.states[i], current.configs.empty() ? cell.config.get() : current.configs[i].get(),
+                            current.correction_factors ? &*current.correction_factors : nullptr, &current.totals,
+                            &new_states[l], &cell_exposures[l]});
+        }
+        exposures.compute_lane_exposures(i, cell, rows);
+
+        for(unsigned int l = 0; l < receiving.size(); ++l) {
+            lane &current = *receiving[l];
+            seaird new_state = lane_next_state(current, i, std::move(new_states[l]), cell_exposures[l]);
+            if(new_state != current.states[i]) {
+                current.states[i] = std::move(new_state);
+                current.next_published[i] = true;
+            }
+        }
+    }
+
+    // geographical_cell::next_state reads the current state and the configuration of the cell, so the shared cell
+    // takes those of the lane for the duration of the call. Only the thread computing a cell uses it.
+    seaird lane_next_state(lane &current, cell_index i, seaird res, std::vector<double> const &cell_exposures) {
+        cell_model &cell = *cells[i];
+        cell.simulation_clock = current.simulation_time;
+        std::swap(cell.state.current_state, current.states[i]);
+        if(!current.configs.empty()) {
+            swap_config(cell, current.configs[i]);
+        }
+        seaird new_state = cell.next_state(std::move(res), cell_exposures);
+        if(!current.configs.empty()) {
+            swap_config(cell, current.configs[i]);
+        }
+        std::swap(cell.state.current_state, current.states[i]);
+        return new_state;
+    }
+
+    static void swap_config(cell_model &cell, std::shared_ptr<const simulation_config> &config) {
+        std::swap(cell.config, config);
+        cell.asymptomatic_rates = cell.config->asymptomatic_rates;
+        cell.prec_divider = cell.config->prec_divider;
+        cell.SIIRS_model = cell.config->SIIRS_model;
+    }
+
+    void end_step(lane &current, log_sink<T> &sink) {
+        for(cell_index i = 0; i < cells.size(); ++i) {
+            if(current.published[i] || current.received[i]) {
+                sink.state(current.simulation_time, i, current.states[i].log_fields());
+            }
+            if(current.next_published[i]) {
+                current.published_states[i] = current.states[i];
+                current.totals.publish(i, current.published_states[i]);
+            }
+        }
+        current.published.swap(current.next_published);
+        std::fill(current.next_published.begin(), current.next_published.end(), false);
+        std::fill(current.received.begin(), current.received.end(), false);
+        current.simulation_time += 1;
+    }
+
+    static simulation_config patch_config(simulation_config config, nlohmann::json const &patch, std::string const &name) {
+        for(auto const &member : patch.items()) {
+            nlohmann::json const &value = member.value();
+            if(member.key() == "precision") {
+                value.get_to(config.prec_divider);
+            } else if(member.key() == "virulence_rates") {
+                value.get_to(config.virulence_rates);
+            } else if(member.key() == "incubation_rates") {
+                value.get_to(config.incubation_rates);
+            } else if(member.key() == "recovery_rates") {
+                value.get_to(config.recovery_rates);
+            } else if(member.key() == "mobility_rates") {
+                value.get_to(config.mobility_rates);
+            } else if(member.key() == "fatality_rates") {
+                value.get_to(config.fatality_rates);
+            } else if(member.key() == "asymptomatic_rates") {
+                value.get_to(config.asymptomatic_rates);
+            } else if(member.key() == "SIIRS_model") {
+                value.get_to(config.SIIRS_model);
+            } else {
+                throw std::invalid_argument{"Unknown member of the config of the variant " + name + ": " + member.key()};
+            }
+        }
+        return config;
+    }
+
+    // Throws an invalid_argument if a patched configuration is not one the cell can run with: the checks of from_json
+    // and of the constructor of geographical_cell, which only assert, and the rates the cell reads for its phases
+    // (see geographical_cell::local_computation). A variant is checked before it runs, as a worker thread would only
+    // find out with an out_of_range in the middle of a step.
+    static void check_config(simulation_config const &config, seaird const &state, std::string const &cell_id,
+                             std::string const &name) {
+        auto invalid = [&](std::string const &reason) {
+            return std::invalid_argument{"The config of the variant " + name + " is invalid for the cell " + cell_id +
+                                         ": " + reason};
+        };
+        if(config.prec_divider < 1) {
+            throw invalid("the precision must be at least 1");
+        }
+        // The rates of a table are read up to the given number of phases in every age group.
+        std::pair<char const *, simulation_config::phase_rates const *> const tables[] = {
+            {"virulence_rates", &config.virulence_rates}, {"incubation_rates", &config.incubation_rates},
+            {"recovery_rates", &config.recovery_rates}, {"mobility_rates", &config.mobility_rates},
+            {"fatality_rates", &config.fatality_rates}};
+        unsigned int const num_infected_phases = state.get_num_infected_phases();
+        unsigned int const num_phases[] = {num_infected_phases, std::max(state.get_num_exposed_phases(), 1u) - 1,
+                                           std::max(num_infected_phases, 1u) - 1, num_infected_phases,
+                                           num_infected_phases};
+        for(unsigned int t = 0; t < 5; ++t) {
+            if(tables[t].second->size() != state.get_num_age_segments()) {
+                throw invalid(std::string{tables[t].first} + " has " + std::to_string(tables[t].second->size()) +
+                              " age groups; the cell has " + std::to_string(state.get_num_age_segments()));
+            }
+            for(auto const &age_group_rates : *tables[t].second) {
+                if(age_group_rates.size() < num_phases[t]) {
+                    throw invalid(std::string{tables[t].first} + " has " + std::to_string(age_group_rates.size()) +
+                                  " rates in an age group; the cell needs " + std::to_string(num_phases[t]));
+                }
+            }
+        }
+        // A sum greater than one is more than the entire population of an infection stage.
+        for(unsigned int age = 0; age < state.get_num_age_segments(); ++age) {
+            std::vector<double> const &recovery_rates = config.recovery_rates[age];
+            std::vector<double> const &fatality_rates = config.fatality_rates[age];
+            for(std::size_t phase = 0; phase < fatality_rates.size(); ++phase) {
+                double recovery_rate = phase < recovery_rates.size() ? recovery_rates[phase] : 0;
+                if(recovery_rate + fatality_rates[phase] > 1.0) {
+                    throw invalid("the recovery rate + fatality rate exceeds 1 in the age group " + std::to_string(age) +
+                                  ", phase " + std::to_string(phase));
+                }
+            }
+        }
+    }
+};
+
+#endif //PANDEMIC_HOYA_2002_PARAMETER_SWEEP_HPP
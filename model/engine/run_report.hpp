@@ -0,0 +1,252 @@
+//
+// Where the time of a run goes: wall time, CPU time and peak memory of its stages, and the time of every simulated day.
+//
+
+#ifndef PANDEMIC_HOYA_2002_RUN_REPORT_HPP
+#define PANDEMIC_HOYA_2002_RUN_REPORT_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include <sys/resource.h>
+#include "log_sink.hpp"
+
+// A run is cut into stages (e.g. loading the scenario, coupling the cells, running it): begin_stage ends the current
+// stage, if any, and starts the next one. Every stage gets the wall time and the CPU time of the process (of all its
+// threads, so it exceeds the wall time when the cells are evaluated in parallel) while it lasted, and the peak RSS of
+// the process at its end.
+//
+// The days are measured by a timed_log_sink wrapped around the sink of the runner: the time of a day goes from one
+// time_step call to the next, and the time spent in the calls of the sink (formatting and writing the logs, or handing
+// them to an async_log_sink) is the logging time of the day; the rest is the time of computing the cells. The cells of
+// a day are the states logged at that day, i.e. the cells that published or received a state. Engines that cannot
+// wrap their logs in a timed_log_sink (Cadmium's runner logs through its own loggers) only time their days, by calling
+// begin_day with sink_timed false: those days have no logging time and no cells.
+class run_report {
+public:
+    struct stage {
+        std::string name;
+        double wall_seconds = 0;
+        double cpu_seconds = 0;
+        double peak_rss_mb = 0;
+    };
+
+    struct day {
+        double time = 0;
+        double wall_seconds = 0;
+        double log_seconds = 0;
+        unsigned long cells = 0;
+        bool sink_timed = true;     // Whether log_seconds and cells were measured
+    };
+
+    void begin_stage(std::string const &name) {
+        end_stage();
+        stages.push_back({name});
+        stage_start = clock::now();
+        stage_cpu_start = cpu_seconds();
+        in_stage = true;
+    }
+
+    void end_stage() {
+        if(!in_stage) {
+            return;
+        }
+        stages.back().wall_seconds = seconds_since(stage_start);
+        stages.back().cpu_seconds = cpu_seconds() - stage_cpu_start;
+        stages.back().peak_rss_mb = peak_rss_mb();
+        in_stage = false;
+    }
+
+    // Starts the day of the given time, ending the current one. The initial states are logged with the first step,
+    // which has the same time: both are one day.
+    void begin_day(double time, bool sink_timed = true) {
+        if(in_day && days.back().time == time) {
+            return;
+        }
+        end_day();
+        days.push_back({time});
+        days.back().sink_timed = sink_timed;
+        day_start = clock::now();
+        in_day = true;
+    }
+
+    void end_day() {
+        if(in_day) {
+            days.back().wall_seconds = seconds_since(day_start);
+            in_day = false;
+        }
+    }
+
+    // Only called between begin_day and end_day.
+    void add_log_time(double seconds) {
+        days.back().log_seconds += seconds;
+    }
+
+    void add_cell() {
+        ++days.back().cells;
+    }
+
+    bool has_day() const {
+        return in_day;
+    }
+
+    std::vector<stage> const &get_stages() const {
+        return stages;
+    }
+
+    std::vector<day> const &get_days() const {
+        return days;
+    }
+
+    // The stages, then a summary of the days.
+    void print(std::ostream &os) const {
+        os << "Run report:\n" << std::fixed << std::setprecision(3);
+        os << "  " << std::left << std::setw(10) << "stage" << std::right << std::setw(12) << "wall (s)"
+           << std::setw(12) << "CPU (s)" << std::setw(16) << "peak RSS (MB)" << "\n";
+        for(auto const &current : stages) {
+            os << "  " << std::left << std::setw(10) << current.name << std::right << std::setw(12)
+               << current.wall_seconds << std::setw(12) << current.cpu_seconds << std::setw(16) << std::setprecision(1)
+               << current.peak_rss_mb << std::setprecision(3) << "\n";
+        }
+        if(!days.empty()) {
+            day total = total_days();
+            auto slowest = std::max_element(days.begin(), days.end(), [](day const &a, day const &b) {
+                return a.wall_seconds < b.wall_seconds;
+            });
+            os << "  " << days.size() << " days in " << total.wall_seconds << " s: " << total.wall_seconds / days.size()
+               << " s per day (slowest: day " << std::defaultfloat << slowest->time << std::fixed << ", "
+               << slowest->wall_seconds << " s)";
+            if(total.sink_timed) {
+                os << ", " << std::setprecision(1) << 100 * total.log_seconds / std::max(total.wall_seconds, 1e-9)
+                   << "% logging, " << std::setprecision(0) << total.cells / std::max(total.wall_seconds, 1e-9)
+                   << " cells per second";
+            }
+            os << "\n";
+        }
+        os << std::defaultfloat << std::setprecision(6);
+        os.flush();
+    }
+
+    void write_json(std::string const &file_path) const {
+        nlohmann::ordered_json report;
+        report["stages"] = nlohmann::ordered_json::array();
+        for(auto const &current : stages) {
+            report["stages"].push_back({{"name", current.name}, {"wall_seconds", current.wall_seconds},
+                                        {"cpu_seconds", current.cpu_seconds}, {"peak_rss_mb", current.peak_rss_mb}});
+        }
+        report["days"] = nlohmann::ordered_json::array();
+        for(auto const &current : days) {
+            nlohmann::ordered_json day_report = {{"time", current.time}, {"wall_seconds", current.wall_seconds}};
+            if(current.sink_timed) {
+                day_report["log_seconds"] = current.log_seconds;
+                day_report["cells"] = current.cells;
+                day_report["cells_per_second"] = current.cells / std::max(current.wall_seconds, 1e-9);
+            }
+            report["days"].push_back(std::move(day_report));
+        }
+
+        std::ofstream file{file_path};
+        if(!file.is_open()) {
+            throw std::runtime_error{"Unable to open the file: " + file_path};
+        }
+        file << report.dump(4) << "\n";
+    }
+
+private:
+    using clock = std::chrono::steady_clock;
+
+    std::vector<stage> stages;
+    std::vector<day> days;
+    clock::time_point stage_start;
+    double stage_cpu_start = 0;
+    bool in_stage = false;
+    clock::time_point day_start;
+    bool in_day = false;
+
+    static double seconds_since(clock::time_point start) {
+        return std::chrono::duration<double>(clock::now() - start).count();
+    }
+
+    static double cpu_seconds() {
+        rusage usage{};
+        getrusage(RUSAGE_SELF, &usage);
+        return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+    }
+
+    // ru_maxrss is in kilobytes on Linux.
+    static double peak_rss_mb() {
+        rusage usage{};
+        getrusage(RUSAGE_SELF, &usage);
+        return usage.ru_maxrss / 1024.0;
+    }
+
+    day total_days() const {
+        day total;
+        for(auto const &current : days) {
+            total.wall_seconds += current.wall_seconds;
+            total.log_seconds += current.log_seconds;
+            total.cells += current.cells;
+            total.sink_timed = total.sink_timed && current.sink_timed;
+        }
+        return total;
+    }
+};
+
+// Forwards every call to another sink, measuring the days and the time spent logging for a run_report.
+template <typename T>
+class timed_log_sink : public log_sink<T> {
+public:
+    timed_log_sink(log_sink<T> &target, run_report &report) : target{target}, report{report} {}
+
+    void start(cell_id_table const &cell_ids) override {
+        timed([&]() { target.start(cell_ids); });
+    }
+
+    void resume(T time, cell_index cell, seaird::log_values const &published_state) override {
+        timed([&]() { target.resume(time, cell, published_state); });
+    }
+
+    void time_step(T time) override {
+        report.begin_day(time);
+        timed([&]() { target.time_step(time); });
+    }
+
+    void message(T time, cell_index cell, seaird::log_values const &published_state) override {
+        timed([&]() { target.message(time, cell, published_state); });
+    }
+
+    void state(T time, cell_index cell, seaird::log_values const &current_state) override {
+        report.add_cell();
+        timed([&]() { target.state(time, cell, current_state); });
+    }
+
+    void finish() override {
+        timed([&]() { target.finish(); });
+        report.end_day();
+    }
+
+private:
+    log_sink<T> &target;
+    run_report &report;
+
+    // Calls before the first day (start and resume) are not part of a day.
+    template <typename F>
+    void timed(F const &call) {
+        if(!report.has_day()) {
+            call();
+            return;
+        }
+        auto start = std::chrono::steady_clock::now();
+        call();
+        report.add_log_time(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    }
+};
+
+#endif //PANDEMIC_HOYA_2002_RUN_REPORT_HPP
@@ -0,0 +1,328 @@
+//
+// Builds a scenario from the region and adjacency CSV files of cadmium_gis and the templates of Scripts/Input_Generator.
+//
+
+#ifndef PANDEMIC_HOYA_2002_SCENARIO_BUILDER_HPP
+#define PANDEMIC_HOYA_2002_SCENARIO_BUILDER_HPP
+
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "compiled_scenario.hpp"
+#include "scenario_loader.hpp"
+#include "thread_pool.hpp"
+
+// Does what the generate_*_json.py scripts of Scripts/Input_Generator do, with the same rules:
+//
+// * regions whose population is missing or zero are invalid, and the adjacency rows that refer to them are skipped,
+// * a cell is created for every region the first time it appears as the region of an adjacency row (cells are written
+//   in that order), with the state of the default cell and the population of the region. A region or a neighbor that
+//   is not in the regions file is an error. The scripts fail too for a region, but write a neighbor missing from the
+//   regions to the neighborhood, where it is not a cell of the scenario and the simulators reject it,
+// * every adjacency row adds the neighbor to the neighborhood of the region, with the correction factors of the default
+//   vicinity and the correlation (shared / region boundary + shared / neighbor boundary) / 2. Rows with a correlation
+//   of 0 are skipped. Every cell is also its own neighbor, with the correlation of the default vicinity,
+// * the state of the infected cells is overwritten with the compartments given for them.
+//
+// The boundary lengths are read from the columns region_boundary, neighbor_boundary and shared_boundary of the
+// adjacency file (see Scripts/Input_Generator/compute_boundary_lengths.py, which adds them from the geometry of the
+// regions). Adjacency files without them are an error, unless the caller accepts the correlation of the default
+// vicinity for every edge.
+class scenario_builder {
+public:
+    struct infected_cell {
+        std::string cell_id;
+        nlohmann::json state;   // The compartments replacing those of the default state
+    };
+
+    // What was skipped while reading the adjacency, as the scripts report it.
+    struct stats {
+        unsigned long invalid_rows = 0;         // Rows referring to a region without population
+        unsigned long zero_correlation_rows = 0;
+        bool boundaries = false;                // Whether the correlations come from the boundary lengths
+    };
+
+    scenario_builder(nlohmann::json default_cell, std::vector<std::string> fields, std::vector<infected_cell> infected_cells) :
+            default_cell(std::move(default_cell)), fields{std::move(fields)}, infected_cells{std::move(infected_cells)} {
+        nlohmann::json const &default_vicinity = this->default_cell.at("neighborhood").at("default_cell_id");
+        default_correlation = default_vicinity.at("correlation");
+        default_correction_factors = default_vicinity.at("infection_correction_factors");
+    }
+
+    // Reads default.json, fields.json and infectedCell.json from an input folder of Scripts/Input_Generator.
+    // infectedCell.json holds an infected cell ({"cell_id": ..., "state": {...}}) or an array of them.
+    static scenario_builder from_input_directory(std::string const &directory) {
+        nlohmann::json infected = read_json(directory + "/infectedCell.json");
+        std::vector<infected_cell> infected_cells;
+        for(auto const &cell : infected.is_array() ? infected : nlohmann::json::array({infected})) {
+            infected_cells.push_back({cell.at("cell_id").get<std::string>(), cell.at("state")});
+        }
+        return scenario_builder{read_json(directory + "/default.json").at("default"),
+                                read_json(directory + "/fields.json").at("fields").get<std::vector<std::string>>(),
+                                std::move(infected_cells)};
+    }
+
+    // Reads the regions: their ID is the first column, and their population the given column (by default, the first
+    // column whose name contains "pop").
+    void read_regions(std::string const &file_path, std::string population_column = "") {
+        std::ifstream file = open(file_path);
+        std::vector<std::string> header;
+        if(!read_csv_line(file, header) || header.empty()) {
+            throw std::invalid_argument{file_path + " is empty"};
+        }
+        unsigned int population_index = population_column.empty() ? find_population_column(header, file_path)
+                                                                   : column_index(header, population_column, file_path);
+
+        std::vector<std::string> row;
+        while(read_csv_line(file, row)) {
+            if(row.size() == 1 && row[0].empty()) {
+                continue;
+            }
+            if(row.size() != header.size()) {
+                throw std::invalid_argument{file_path + ": every line must have " + std::to_string(header.size()) + " columns"};
+            }
+            std::string const &population = row[population_index];
+            populations[row[0]] = population.empty() ? 0 : parse_number(population, file_path);
+        }
+    }
+
+    // Reads the adjacency: the region is the first column and the neighbor the second. Without boundary lengths, every
+    // edge gets the default correlation if allow_default_correlation is set.
+    stats read_adjacency(std::string const &file_path, bool allow_default_correlation = false) {
+        std::ifstream file = open(file_path);
+        std::vector<std::string> header;
+        if(!read_csv_line(file, header) || header.size() < 2) {
+            throw std::invalid_argument{file_path + " must have a region and a neighbor column"};
+        }
+        stats current_stats;
+        auto boundary = [&](std::string const &name) {
+            auto found = std::find(header.begin(), header.end(), name);
+            return found == header.end() ? -1 : static_cast<int>(found - header.begin());
+        };
+        int region_boundary = boundary("region_boundary");
+        int neighbor_boundary = boundary("neighbor_boundary");
+        int shared_boundary = boundary("shared_boundary");
+        current_stats.boundaries = region_boundary >= 0 && neighbor_boundary >= 0 && shared_boundary >= 0;
+        if(!current_stats.boundaries && !allow_default_correlation) {
+            throw std::invalid_argument{file_path + " has no region_boundary, neighbor_boundary and shared_boundary columns"
+                                        " (see Scripts/Input_Generator/compute_boundary_lengths.py)"};
+        }
+
+        std::vector<std::string> row;
+        while(read_csv_line(file, row)) {
+            if(row.size() == 1 && row[0].empty()) {
+                continue;
+            }
+            if(row.size() != header.size()) {
+                throw std::invalid_argument{file_path + ": every line must have " + std::to_string(header.size()) + " columns"};
+            }
+            std::string const &region = row[0];
+            std::string const &neighbor = row[1];
+            if(!valid(region) || !valid(neighbor)) {
+                ++current_stats.invalid_rows;
+                continue;
+            }
+
+            auto cell = cell_indices.find(region);
+            if(cell == cell_indices.end()) {
+                cell = cell_indices.insert({region, cells.size()}).first;
+                nlohmann::json config = nlohmann::json::object();
+                config["state"] = default_cell.at("state");
+                config["state"]["population"] = populations.at(region);
+                config["neighborhood"] = nlohmann::json::object();
+                cells.push_back({region, std::move(config)});
+            }
+
+            double correlation = default_correlation;
+            if(current_stats.boundaries) {
+                double shared = parse_number(row[shared_boundary], file_path);
+                correlation = (shared / parse_number(row[region_boundary], file_path) +
+                               shared / parse_number(row[neighbor_boundary], file_path)) / 2;
+            }
+            if(correlation == 0) {
+                ++current_stats.zero_correlation_rows;
+                continue;
+            }
+            cells[cell->second].config["neighborhood"][neighbor] = vicinity_json(correlation);
+        }
+        return current_stats;
+    }
+
+    // Writes the scenario as the scripts do: the default cell, the cells in the order in which they were created, then
+    // the fields.
+    void write_json(std::ostream &os) {
+        finish_cells();
+        os << "{\n    \"cells\": {\n        \"default\": " << default_cell.dump();
+        for(auto const &cell : cells) {
+            os << ",\n        " << nlohmann::json(cell.cell_id).dump() << ": " << cell.config.dump();
+        }
+        os << "\n    },\n    \"fields\": " << nlohmann::json(fields).dump() << "\n}\n";
+    }
+
+    // Writes the scenario in compiled form (see compiled_scenario.hpp). Its source hash is the hash of the JSON form,
+    // so it is found in a scenario cache when the JSON form is run.
+    void write_compiled(std::string const &file_path, unsigned int num_threads = 1) {
+        std::ostringstream json;
+        write_json(json);
+        std::string text = json.str();
+
+        compiled_scenario::scenario compiled;
+        compiled.fields = fields;
+        compiled.cell_order.push_back("default");
+        compiled.cells.resize(cells.size());
+        for(auto const &cell : cells) {
+            compiled.cell_order.push_back(cell.cell_id);
+        }
+        thread_pool pool{num_threads};
+        pool.parallel_for(cells.size(), [&](unsigned int i) {
+            nlohmann::json cell_config = default_cell;
+            cell_config.merge_patch(cells[i].config);
+            compiled.cells[i] = scenario_loader::parse_cell(cells[i].cell_id, std::move(cell_config));
+        });
+        std::sort(compiled.cells.begin(), compiled.cells.end(),
+                  [](cell_definition const &a, cell_definition const &b) { return a.cell_id < b.cell_id; });
+        compiled_scenario::write(file_path, compiled, compiled_scenario::hash_bytes(text.data(), text.size()));
+    }
+
+    unsigned long get_num_cells() const {
+        return cells.size();
+    }
+
+private:
+    struct cell {
+        std::string cell_id;
+        nlohmann::json config;
+    };
+
+    nlohmann::json default_cell;
+    std::vector<std::string> fields;
+    std::vector<infected_cell> infected_cells;
+    double default_correlation;
+    nlohmann::json default_correction_factors;
+
+    std::unordered_map<std::string, double> populations;
+    std::unordered_map<std::string, unsigned long> cell_indices;
+    std::vector<cell> cells;
+    bool finished = false;
+
+    // Adds every cell to its own neighborhood and infects the infected cells.
+    void finish_cells() {
+        if(finished) {
+            return;
+        }
+        for(auto &cell : cells) {
+            cell.config["neighborhood"][cell.cell_id] = vicinity_json(default_correlation);
+        }
+        for(auto const &infected : infected_cells) {
+            auto cell = cell_indices.find(infected.cell_id);
+            if(cell == cell_indices.end()) {
+                throw std::invalid_argument{"The infected cell " + infected.cell_id + " is not a cell of the scenario"};
+            }
+            for(auto const &compartment : infected.state.items()) {
+                cells[cell->second].config["state"][compartment.key()] = compartment.value();
+            }
+        }
+        finished = true;
+    }
+
+    nlohmann::json vicinity_json(double correlation) const {
+        return {{"correlation", correlation}, {"infection_correction_factors", default_correction_factors}};
+    }
+
+    bool valid(std::string const &region) const {
+        auto population = populations.find(region);
+        if(population == populations.end()) {
+            throw std::invalid_argument{"The region " + region + " of the adjacency is not in the regions file"};
+        }
+        return population->second != 0;
+    }
+
+    static std::ifstream open(std::string const &file_path) {
+        std::ifstream file{file_path};
+        if(!file.is_open()) {
+            throw std::runtime_error{"Unable to open the file: " + file_path};
+        }
+        return file;
+    }
+
+    static nlohmann::json read_json(std::string const &file_path) {
+        std::ifstream file = open(file_path);
+        nlohmann::json json;
+        file >> json;
+        return json;
+    }
+
+    static double parse_number(std::string const &value, std::string const &file_path) {
+        try {
+            std::size_t parsed = 0;
+            double number = std::stod(value, &parsed);
+            if(parsed == value.size()) {
+                return number;
+            }
+        } catch(std::logic_error const &) {
+        }
+        throw std::invalid_argument{file_path + ": not a number: " + value};
+    }
+
+    static unsigned int column_index(std::vector<std::string> const &header, std::string const &column,
+                                     std::string const &file_path) {
+        auto found = std::find(header.begin(), header.end(), column);
+        if(found == header.end()) {
+            throw std::invalid_argument{file_path + " has no column " + column};
+        }
+        return found - header.begin();
+    }
+
+    static unsigned int find_population_column(std::vector<std::string> const &header, std::string const &file_path) {
+        for(unsigned int i = 0; i < header.size(); ++i) {
+            std::string name = header[i];
+            std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return std::tolower(c); });
+            if(name.find("pop") != std::string::npos) {
+                return i;
+            }
+        }
+        throw std::invalid_argument{file_path + " has no population column"};
+    }
+
+    // Reads the fields of a CSV line; fields may be quoted, with "" for a quote.
+    static bool read_csv_line(std::istream &is, std::vector<std::string> &fields) {
+        std::string line;
+        if(!std::getline(is, line)) {
+            return false;
+        }
+        if(!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        fields.assign(1, "");
+        bool quoted = false;
+        for(std::size_t i = 0; i < line.size(); ++i) {
+            char c = line[i];
+            if(quoted) {
+                if(c == '"' && i + 1 < line.size() && line[i + 1] == '"') {
+                    fields.back() += '"';
+                    ++i;
+                } else if(c == '"') {
+                    quoted = false;
+                } else {
+                    fields.back() += c;
+                }
+            } else if(c == '"') {
+                quoted = true;
+            } else if(c == ',') {
+                fields.emplace_back();
+            } else {
+                fields.back() += c;
+            }
+        }
+        return true;
+    }
+};
+
+#endif //PANDEMIC_HOYA_2002_SCENARIO_BUILDER_HPP
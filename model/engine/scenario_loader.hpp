@@ -0,0 +1,353 @@
+//
+// Loads the cells of a scenario file without building the JSON document of the whole file.
+//
+
+#ifndef PANDEMIC_HOYA_2002_SCENARIO_LOADER_HPP
+#define PANDEMIC_HOYA_2002_SCENARIO_LOADER_HPP
+
+#include <algorithm>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "../cells/seaird.hpp"
+#include "../cells/simulation_config.hpp"
+#include "../cells/vicinity.hpp"
+#include "config_pool.hpp"
+#include "thread_pool.hpp"
+
+// A cell of a scenario, as cells_coupled::add_cells_json passes it to add_cell_json.
+struct cell_definition {
+    std::string cell_id;
+    std::string cell_type;
+    std::string delay_id;
+    std::unordered_map<std::string, vicinity> neighborhood;
+    seaird initial_state;
+    std::shared_ptr<const simulation_config> config;   // Interned by the loaders (see config_pool.hpp)
+};
+
+// Reads a scenario file with the same rules as cells_coupled::add_cells_json (every cell is the "default" cell patched
+// with the cell's own entries), but without its peak memory: the file is read by blocks, and a scanner that only
+// follows the nesting of the JSON text cuts the "cells" object into the text of every cell. The cells are parsed and
+// converted by batches of batch_size, the cells of a batch in parallel on the given pool, so at any time only the text
+// and the JSON documents of one batch exist besides the definitions already built.
+//
+// Equal configurations are interned, so the definitions of the cells with the same configuration share it.
+//
+// The definitions are returned sorted by cell ID, which is the order in which nlohmann::json iterates the cells and
+// thus the order in which Cadmium adds the cells of a scenario to the coupled model.
+class scenario_loader {
+public:
+    static std::vector<cell_definition> load(std::string const &file_path, thread_pool &pool,
+                                             unsigned int batch_size = 256) {
+        scenario_loader loader{file_path};
+        loader.scan(pool, std::max(1u, batch_size));
+        std::sort(loader.definitions.begin(), loader.definitions.end(),
+                  [](cell_definition const &a, cell_definition const &b) { return a.cell_id < b.cell_id; });
+        for(unsigned int i = 1; i < loader.definitions.size(); ++i) {
+            if(loader.definitions[i].cell_id == loader.definitions[i - 1].cell_id) {
+                throw std::invalid_argument{"The cell " + loader.definitions[i].cell_id + " is defined more than once"};
+            }
+        }
+        return std::move(loader.definitions);
+    }
+
+    // Reads the "fields" section of a scenario file (the names of the logged values for the GIS viewer), skipping the
+    // cells. Returns no fields if the scenario has none.
+    static std::vector<std::string> read_fields(std::string const &file_path) {
+        scenario_loader loader{file_path};
+        std::vector<std::string> fields;
+        loader.expect('{');
+        if(loader.skip_whitespace() == '}') {
+            return fields;
+        }
+        do {
+            std::string key = loader.read_key();
+            if(key == "fields") {
+                std::string text;
+                loader.read_value(&text);
+                nlohmann::json::parse(text).get_to(fields);
+            } else {
+                loader.read_value(nullptr);
+            }
+        } while(loader.next_member('}'));
+        return fields;
+    }
+
+    // Reads the IDs of the cells of a scenario file in the order of the file, "default" included, skipping their
+    // definitions. This is the order of the nodes of the message log parser (see gis_viewer_writer.hpp).
+    static std::vector<std::string> read_cell_order(std::string const &file_path) {
+        scenario_loader loader{file_path};
+        std::vector<std::string> cell_ids;
+        loader.expect('{');
+        if(loader.skip_whitespace() == '}') {
+            return cell_ids;
+        }
+        do {
+            std::string key = loader.read_key();
+            if(key != "cells") {
+                loader.read_value(nullptr);
+                continue;
+            }
+            loader.expect('{');
+            if(loader.skip_whitespace() == '}') {
+                loader.get();
+                continue;
+            }
+            do {
+                cell_ids.push_back(loader.read_key());
+                loader.read_value(nullptr);
+            } while(loader.next_member('}'));
+        } while(loader.next_member('}'));
+        return cell_ids;
+    }
+
+    // Converts the configuration of a cell, the default cell already applied.
+    static cell_definition parse_cell(std::string const &cell_id, nlohmann::json cell_config) {
+        cell_definition definition;
+        definition.cell_id = cell_id;
+        // The default neighborhood only holds the template vicinity used by the scenario generators.
+        cell_config.at("neighborhood").erase("default_cell_id");
+        cell_config.at("cell_type").get_to(definition.cell_type);
+        cell_config.at("delay").get_to(definition.delay_id);
+        cell_config.at("neighborhood").get_to(definition.neighborhood);
+        cell_config.at("state").get_to(definition.initial_state);
+        definition.config = std::make_shared<const simulation_config>(cell_config.at("config").get<simulation_config>());
+        return definition;
+    }
+
+private:
+    struct raw_cell {
+        std::string cell_id;
+        std::string text;
+    };
+
+    std::string file_path;
+    std::ifstream file;
+    std::vector<char> block;
+    std::size_t block_position = 0;
+    std::size_t block_size = 0;
+    std::size_t offset = 0;         // Offset in the file of the next character
+
+    bool default_found = false;
+    nlohmann::json default_config = nlohmann::json::object();
+    std::vector<raw_cell> batch;
+    std::vector<cell_definition> definitions;
+    config_pool configs;
+
+    explicit scenario_loader(std::string const &file_path) : file_path{file_path}, file{file_path, std::ios::binary},
+                                                             block(1 << 20) {
+        if(!file.is_open()) {
+            throw std::runtime_error{"Unable to open the file: " + file_path};
+        }
+    }
+
+    void scan(thread_pool &pool, unsigned int batch_size) {
+        bool cells_found = false;
+        expect('{');
+        if(skip_whitespace() == '}') {
+            get();
+        } else {
+            while(true) {
+                std::string key = read_key();
+                if(key == "cells") {
+                    cells_found = true;
+                    scan_cells(pool, batch_size);
+                } else {
+                    read_value(nullptr);
+                }
+                if(!next_member('}')) {
+                    break;
+                }
+            }
+        }
+        if(!cells_found) {
+            throw std::invalid_argument{"The scenario " + file_path + " has no cells"};
+        }
+    }
+
+    void scan_cells(thread_pool &pool, unsigned int batch_size) {
+        expect('{');
+        if(skip_whitespace() == '}') {
+            get();
+            return;
+        }
+        while(true) {
+            raw_cell cell;
+            cell.cell_id = read_key();
+            read_value(&cell.text);
+            if(cell.cell_id == "default") {
+                default_config = nlohmann::json::parse(cell.text);
+                default_found = true;
+            } else {
+                batch.push_back(std::move(cell));
+            }
+            // Cells found before the default cell wait for it (the scenario generators write it first).
+            if(default_found && batch.size() >= batch_size) {
+                build_batch(pool);
+            }
+            if(!next_member('}')) {
+                break;
+            }
+        }
+        build_batch(pool);
+    }
+
+    void build_batch(thread_pool &pool) {
+        std::size_t first = definitions.size();
+        definitions.resize(first + batch.size());
+        pool.parallel_for(batch.size(), [&](unsigned int i) {
+            nlohmann::json cell_config = default_config;
+            cell_config.merge_patch(nlohmann::json::parse(batch[i].text));
+            definitions[first + i] = parse_cell(batch[i].cell_id, std::move(cell_config));
+        });
+        for(std::size_t i = first; i < definitions.size(); ++i) {
+            definitions[i].config = configs.intern(std::move(definitions[i].config));
+        }
+        batch.clear();
+    }
+
+    // Reads a member name and the colon after it.
+    std::string read_key() {
+        if(skip_whitespace() != '"') {
+            fail("expected a member name");
+        }
+        std::string text;
+        read_string(&text);
+        expect(':');
+        return nlohmann::json::parse(text).get<std::string>();
+    }
+
+    // After a member or an element: returns true on a comma, false on the closing character.
+    bool next_member(char closing) {
+        char next = get_after_whitespace();
+        if(next == ',') {
+            return true;
+        }
+        if(next != closing) {
+            fail(std::string{"expected ',' or '"} + closing + "'");
+        }
+        return false;
+    }
+
+    // Reads a value without parsing it, appending its text to text (if not null).
+    void read_value(std::string *text) {
+        char first = skip_whitespace();
+        if(first == '"') {
+            read_string(text);
+            return;
+        }
+        if(first != '{' && first != '[') {
+            // A number or a literal: everything up to the next delimiter.
+            while(true) {
+                int next = peek();
+                if(next == EOF || next == ',' || next == '}' || next == ']' || is_whitespace(next)) {
+                    return;
+                }
+                append(text, get());
+            }
+        }
+
+        unsigned long depth = 0;
+        do {
+            int next = peek();
+            if(next == EOF) {
+                fail("unexpected end of the file");
+            }
+            if(next == '"') {
+                read_string(text);
+                continue;
+            }
+            append(text, get());
+            if(next == '{' || next == '[') {
+                ++depth;
+            } else if(next == '}' || next == ']') {
+                --depth;
+            }
+        } while(depth > 0);
+    }
+
+    // Reads a string, quotes and escapes included, appending its text to text (if not null).
+    void read_string(std::string *text) {
+        append(text, get());
+        while(true) {
+            int next = get();
+            if(next == EOF) {
+                fail("unterminated string");
+            }
+            append(text, next);
+            if(next == '\\') {
+                int escaped = get();
+                if(escaped == EOF) {
+                    fail("unterminated string");
+                }
+                append(text, escaped);
+            } else if(next == '"') {
+                return;
+            }
+        }
+    }
+
+    static void append(std::string *text, int character) {
+        if(text) {
+            text->push_back(static_cast<char>(character));
+        }
+    }
+
+    static bool is_whitespace(int character) {
+        return character == ' ' || character == '\t' || character == '\n' || character == '\r';
+    }
+
+    void expect(char expected) {
+        if(get_after_whitespace() != expected) {
+            fail(std::string{"expected '"} + expected + "'");
+        }
+    }
+
+    char get_after_whitespace() {
+        skip_whitespace();
+        int next = get();
+        if(next == EOF) {
+            fail("unexpected end of the file");
+        }
+        return static_cast<char>(next);
+    }
+
+    // Returns the next character that is not a whitespace, without consuming it.
+    int skip_whitespace() {
+        while(is_whitespace(peek())) {
+            get();
+        }
+        return peek();
+    }
+
+    int peek() {
+        if(block_position == block_size) {
+            file.read(block.data(), block.size());
+            block_size = file.gcount();
+            block_position = 0;
+            if(block_size == 0) {
+                return EOF;
+            }
+        }
+        return static_cast<unsigned char>(block[block_position]);
+    }
+
+    int get() {
+        int next = peek();
+        if(next != EOF) {
+            ++block_position;
+            ++offset;
+        }
+        return next;
+    }
+
+    [[noreturn]] void fail(std::string const &reason) const {
+        throw std::runtime_error{"Malformed scenario " + file_path + " at offset " + std::to_string(offset) + ": " + reason};
+    }
+};
+
+#endif //PANDEMIC_HOYA_2002_SCENARIO_LOADER_HPP
@@ -0,0 +1,414 @@
+//
+// Bulk-synchronous alternative to Cadmium's PDEVS runner for geographical_coupled scenarios.
+//
+
+#ifndef PANDEMIC_HOYA_2002_SYNCHRONOUS_RUNNER_HPP
+#define PANDEMIC_HOYA_2002_SYNCHRONOUS_RUNNER_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <memory>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <typeinfo>
+#include <unordered_map>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "../cells/geographical_cell.hpp"
+#include "cell_id_table.hpp"
+#include "checkpoint.hpp"
+#include "compiled_scenario.hpp"
+#include "config_pool.hpp"
+#include "exposure_matrix.hpp"
+#include "log_sink.hpp"
+#include "scenario_loader.hpp"
+#include "thread_pool.hpp"
+
+// Every geographical_cell communicates its new state with an output delay of 1, so a scenario is a synchronous lattice:
+// at time t the cells that changed publish their state, every cell that has one of them in its neighborhood receives
+// it and computes its next state, and the cells whose state changed publish it at t + 1. This runner executes exactly
+// these rules over arrays instead of routing every message through Cadmium's coordinators and scheduler:
+//
+// * the states published at t are kept in their own array while the cells compute the states to publish at t + 1,
+//   so every cell of a step reads the states of the previous step only and the cells can be evaluated in parallel,
+// * the neighbors of every cell are indexed once when the cells are coupled, so receiving the published states is
+//   a walk over a precomputed list,
+// * the new exposed of every cell are computed from an exposure_matrix, which holds the neighborhoods in CSR form
+//   and the published totals in flat arrays, instead of string keyed lookups in the neighbors_state of the cells.
+//
+// What is logged is reported to a log_sink. The text_log_sink writes the message and state logs in the same format as
+// the Cadmium loggers of main.cpp. Cells are visited in the order of their IDs (the order of scenario_loader), while
+// Cadmium's runner logs the cells of a time step in an order of its own: the logs of both engines have the same
+// records at every time step, in a different order within the step. test/engine_test.cpp compares them so.
+template <typename T>
+class synchronous_runner {
+public:
+    using cell_model = geographical_cell<T>;
+
+    template <typename X>
+    using cell_unordered = std::unordered_map<std::string, X>;
+
+    // Loads the cells of a scenario file with the same rules as cells_coupled::add_cells_json: every cell is the
+    // "default" cell patched with the cell's own entries. The file is streamed and its cells are parsed in parallel
+    // batches on the threads set by set_num_threads (see scenario_loader).
+    void add_cells_json(std::string const &file_in) {
+        if(!pool) {
+            set_num_threads(1);
+        }
+        for(auto &definition : scenario_loader::load(file_in, *pool)) {
+            add_cell(std::move(definition));
+        }
+    }
+
+    // Loads the cells of a scenario compiled by compiled_scenario::compile, without parsing any JSON.
+    void add_cells_compiled(std::string const &file_in) {
+        for(auto &definition : compiled_scenario::read(file_in).cells) {
+            add_cell(std::move(definition));
+        }
+    }
+
+    void add_cell(cell_definition definition) {
+        if(definition.cell_type != "zhong") {
+            throw std::bad_typeid();
+        }
+        if(cell_ids.contains(definition.cell_id)) {
+            throw std::invalid_argument{"The cell " + definition.cell_id + " is defined more than once"};
+        }
+
+        auto new_cell = std::make_unique<cell_model>(definition.cell_id, definition.neighborhood, definition.initial_state,
+                                                     definition.delay_id, configs.intern(std::move(definition.config)));
+
+        if(new_cell->output_delay(new_cell->state.current_state) != 1) {
+            throw std::invalid_argument{"The synchronous runner requires every cell to have an output delay of 1"};
+        }
+
+        cell_ids.intern(definition.cell_id);
+        cells.push_back(std::move(new_cell));
+    }
+
+    void add_cell_json(std::string const &cell_type, std::string const &cell_id, cell_unordered<vicinity> const &neighborhood,
+                       seaird const &initial_state, std::string const &delay_id, nlohmann::json const &config) {
+        add_cell({cell_id, cell_type, delay_id, neighborhood, initial_state,
+                  std::make_shared<const simulation_config>(config.get<typename cell_model::config_type>())});
+    }
+
+    // Builds the neighbor index. Must be called once all the cells were added, and before run_until.
+    void couple_cells() {
+        neighbor_indices.assign(cells.size(), {});
+
+        for(cell_index i = 0; i < cells.size(); ++i) {
+            for(auto const &neighbor : cells[i]->neighbors) {
+                if(!cell_ids.contains(neighbor)) {
+                    throw std::invalid_argument{"The cell " + cells[i]->cell_id + " has an unknown neighbor: " + neighbor};
+                }
+                neighbor_indices[i].push_back(cell_ids.index_of(neighbor));
+            }
+        }
+
+        exposures.build(cells, cell_ids);
+
+#ifdef PANDEMIC_HOT_PATH_COUNTERS
+        // A published state is routed to every cell that has the publishing cell as a neighbor.
+        num_receivers.assign(cells.size(), 0);
+        for(auto const &row : neighbor_indices) {
+            for(auto neighbor : row) {
+                ++num_receivers[neighbor];
+            }
+        }
+#endif
+
+        // At the start of the simulation every cell publishes its initial state.
+        published_states.clear();
+        for(auto const &cell : cells) {
+            published_states.push_back(cell->state.current_state);
+        }
+        published.assign(cells.size(), true);
+        next_published.assign(cells.size(), false);
+        received.assign(cells.size(), false);
+        coupled = true;
+    }
+
+    // The cells of a time step are evaluated by num_threads threads (1 by default). Each cell only reads the states
+    // published at the previous step and only writes its own state, so the results do not depend on the thread count.
+    void set_num_threads(unsigned int num_threads) {
+        pool = std::make_unique<thread_pool>(num_threads);
+    }
+
+    // Runs every time step strictly before end_time (as Cadmium's runner does), writing the text logs.
+    T run_until(T end_time, std::ostream &messages_log, std::ostream &state_log) {
+        text_log_sink<T> sink{messages_log, state_log};
+        return run_until(end_time, sink);
+    }
+
+    // Runs every time step strictly before end_time and returns the time of the next step. The same sink must be
+    // used by every call on a runner.
+    T run_until(T end_time, log_sink<T> &sink) {
+        if(!coupled) {
+            throw std::logic_error{"couple_cells must be called before run_until"};
+        }
+        if(!pool) {
+            set_num_threads(1);
+        }
+
+        start(sink);
+        while(has_step_before(end_time)) {
+            begin_step(sink);
+            // Every cell that received a state from one of its neighbors at this step computes its next one. The totals
+            // published at this step are only replaced once all the cells are done.
+            pool->parallel_for(cells.size(), [this](cell_index i) { step_cell(i); });
+            end_step(sink);
+            if(checkpoint_interval > 0 && std::fmod(simulation_time, checkpoint_interval) == 0) {
+                write_checkpoint(checkpoint::file_name(checkpoint_prefix, simulation_time));
+            }
+        }
+        // The checkpoint of the end of the run, from which it can be extended to a longer horizon.
+        if(checkpoint_interval > 0 && std::fmod(simulation_time, checkpoint_interval) != 0) {
+            write_checkpoint(checkpoint::file_name(checkpoint_prefix, simulation_time));
+        }
+
+        sink.finish();
+        return simulation_time;
+    }
+
+    // run_until writes a checkpoint (see checkpoint.hpp) to prefix_TIME.bin whenever the time of the next step is a
+    // multiple of interval, and at the end of the run.
+    void set_checkpoints(T interval, std::string const &prefix) {
+        checkpoint_interval = interval;
+        checkpoint_prefix = prefix;
+    }
+
+    // The state of the simulation between two steps: the time of the next step, the states of the cells and which of
+    // them published their state at the last step. The states share their buffers with those of the cells.
+    checkpoint::snapshot<T> take_snapshot() const {
+        if(!coupled) {
+            throw std::logic_error{"couple_cells must be called before taking a snapshot"};
+        }
+        checkpoint::snapshot<T> saved;
+        saved.time = simulation_time;
+        saved.published = published;
+        for(auto const &cell : cells) {
+            saved.states.push_back(cell->state.current_state);
+        }
+        return saved;
+    }
+
+    // Restores a snapshot of a runner of the same scenario, after couple_cells and before the first run_until.
+    // Running on from there logs exactly the time steps that the original run logged (or would have logged) from the
+    // time of the snapshot on; the initial states are not logged again.
+    void restore(checkpoint::snapshot<T> saved) {
+        if(!coupled || initialized) {
+            throw std::logic_error{"A snapshot must be restored after couple_cells and before the simulation starts"};
+        }
+        if(saved.states.size() != cells.size() || saved.published.size() != cells.size()) {
+            throw std::invalid_argument{"The snapshot does not have the cells of the scenario"};
+        }
+        for(cell_index i = 0; i < cells.size(); ++i) {
+            seaird const &state = saved.states[i];
+            seaird const &initial_state = cells[i]->state.current_state;
+            try {
+                checkpoint::check_state(state, cells[i]->neighbors.size(), cells[i]->cell_id);
+            } catch(std::runtime_error const &error) {
+                throw std::invalid_argument{std::string{"The snapshot does not match the scenario: "} + error.what()};
+            }
+            // The exposure matrix was built for the age groups and phases of the cells.
+            if(state.get_num_age_segments() != initial_state.get_num_age_segments() ||
+               state.get_num_exposed_phases() != initial_state.get_num_exposed_phases() ||
+               state.get_num_infected_phases() != initial_state.get_num_infected_phases() ||
+               state.get_num_recovered_phases() != initial_state.get_num_recovered_phases()) {
+                throw std::invalid_argument{"The snapshot does not match the age groups and phases of the cell " +
+                                            cells[i]->cell_id};
+            }
+        }
+        for(cell_index i = 0; i < cells.size(); ++i) {
+            cells[i]->state.current_state = std::move(saved.states[i]);
+            published_states[i] = cells[i]->state.current_state;
+            exposures.publish(i, published_states[i]);
+        }
+        published = std::move(saved.published);
+        simulation_time = saved.time;
+        initialized = true;
+        resumed = true;
+    }
+
+    void write_checkpoint(std::string const &file_path) const {
+        checkpoint::write(file_path, take_snapshot(), cell_ids);
+    }
+
+    // Restores a checkpoint written by write_checkpoint for the same scenario (see restore).
+    void resume_from_checkpoint(std::string const &file_path) {
+        if(!coupled) {
+            throw std::logic_error{"A checkpoint must be restored after couple_cells and before the simulation starts"};
+        }
+        std::vector<std::size_t> num_neighbors;
+        for(auto const &cell : cells) {
+            num_neighbors.push_back(cell->neighbors.size());
+        }
+        restore(checkpoint::read<T>(file_path, cell_ids, num_neighbors));
+    }
+
+    // The steps of run_until, for callers that drive a runner step by step: start once, then while
+    // has_step_before(end_time), begin_step, step_cell for every cell (concurrently if wanted) and end_step. The sink
+    // is not finished. parameter_sweep steps its lanes with the same rules.
+    void start(log_sink<T> &sink) {
+        if(!coupled) {
+            throw std::logic_error{"couple_cells must be called before the simulation starts"};
+        }
+        if(!sink_started) {
+            sink.start(cell_ids);
+            sink_started = true;
+            if(resumed) {
+                for(cell_index i = 0; i < cells.size(); ++i) {
+                    sink.resume(simulation_time, i, published_states[i].log_fields());
+                }
+            }
+        }
+        if(!initialized) {
+            sink.time_step(simulation_time);
+            for(cell_index i = 0; i < cells.size(); ++i) {
+                sink.state(simulation_time, i, cells[i]->state.current_state.log_fields());
+            }
+            initialized = true;
+        }
+    }
+
+    bool has_step_before(T end_time) const {
+        return simulation_time < end_time && any_published();
+    }
+
+    void begin_step(log_sink<T> &sink) {
+        sink.time_step(simulation_time);
+        for(cell_index i = 0; i < cells.size(); ++i) {
+            if(published[i]) {
+                sink.message(simulation_time, i, published_states[i].log_fields());
+                HOT_PATH_COUNT(cells[i]->counters, messages_routed, num_receivers[i]);
+            }
+        }
+    }
+
+    // Computes the next state of a cell if one of its neighbors published its state at this step. Only writes the state
+    // of the cell, so the cells of a step can be computed concurrently.
+    void step_cell(cell_index i) {
+        for(auto neighbor : neighbor_indices[i]) {
+            if(published[neighbor]) {
+                received[i] = true;
+                break;
+            }
+        }
+        if(!received[i]) {
+            return;
+        }
+
+        cell_model &current_cell = *cells[i];
+        current_cell.simulation_clock = simulation_time;
+
+        // The exposures are computed from the matrix, so the neighbors_state of the cells is never filled.
+        seaird new_state = current_cell.state.current_state;
+        std::vector<double> cell_exposures;
+        exposures.compute_exposures(i, current_cell, new_state, cell_exposures);
+        new_state = current_cell.next_state(std::move(new_state), cell_exposures);
+
+        if(new_state != current_cell.state.current_state) {
+            current_cell.state.current_state = std::move(new_state);
+            next_published[i] = true;
+            HOT_PATH_COUNT(current_cell.counters, messages_emitted, 1);
+        }
+    }
+
+    void end_step(log_sink<T> &sink) {
+        for(cell_index i = 0; i < cells.size(); ++i) {
+            if(published[i] || received[i]) {
+                sink.state(simulation_time, i, cells[i]->state.current_state.log_fields());
+            }
+            if(next_published[i]) {
+                published_states[i] = cells[i]->state.current_state;
+                exposures.publish(i, published_states[i]);
+            }
+        }
+#ifdef PANDEMIC_HOT_PATH_COUNTERS
+        hot_path_counters total;
+        for(auto const &cell : cells) {
+            total += cell->counters;
+        }
+        daily_counters.push_back({simulation_time, total - counted});
+        counted = total;
+#endif
+
+        published.swap(next_published);
+        std::fill(next_published.begin(), next_published.end(), false);
+        std::fill(received.begin(), received.end(), false);
+        simulation_time += 1;
+    }
+
+    T get_simulation_time() const {
+        return simulation_time;
+    }
+
+    std::vector<std::unique_ptr<cell_model>> const &get_cells() const {
+        return cells;
+    }
+
+    cell_id_table const &get_cell_ids() const {
+        return cell_ids;
+    }
+
+#ifdef PANDEMIC_HOT_PATH_COUNTERS
+    // Writes the counters of the hot path (see hot_path_counters.hpp) of every step this runner simulated, and those of
+    // every cell over all of them, as CSV.
+    void write_hot_path_counters(std::ostream &days, std::ostream &cells_counters) const {
+        hot_path_counters::write_csv_header(days << "time,") << "\n";
+        for(auto const &day : daily_counters) {
+            day.second.write_csv(days << day.first << ",") << "\n";
+        }
+        hot_path_counters::write_csv_header(cells_counters << "cell_id,neighbors,") << "\n";
+        for(auto const &cell : cells) {
+            cell->counters.write_csv(cells_counters << cell->cell_id << "," << cell->neighbors.size() << ",") << "\n";
+        }
+    }
+#endif
+
+private:
+    std::vector<std::unique_ptr<cell_model>> cells;
+    // The index of a cell in cells is its index in cell_ids. Once the cells are coupled, cells are only referred to by
+    // index; the string IDs are only used for logging.
+    cell_id_table cell_ids;
+    // The configurations of the cells; cells with equal configurations share one.
+    config_pool configs;
+
+    // neighbor_indices[i] holds the indices of the neighbors of cell i, in the order of cells[i]->neighbors.
+    std::vector<std::vector<cell_index>> neighbor_indices;
+
+    // The states published at the current time step, and the double buffered flags of the cells publishing their
+    // state at the current and at the next time step. The flags are written concurrently, hence not std::vector<bool>.
+    std::vector<seaird> published_states;
+    std::vector<char> published;
+    std::vector<char> next_published;
+    std::vector<char> received;
+
+    exposure_matrix<T> exposures;
+    std::unique_ptr<thread_pool> pool;
+
+#ifdef PANDEMIC_HOT_PATH_COUNTERS
+    // The number of cells that have each cell as a neighbor, the counters of every step and their sum over the cells
+    // at the end of the last step.
+    std::vector<unsigned int> num_receivers;
+    std::vector<std::pair<T, hot_path_counters>> daily_counters;
+    hot_path_counters counted;
+#endif
+
+    T simulation_time = 0;
+    bool coupled = false;
+    bool initialized = false;
+    bool sink_started = false;
+    bool resumed = false;
+
+    T checkpoint_interval = 0;
+    std::string checkpoint_prefix;
+
+    bool any_published() const {
+        return std::find(published.begin(), published.end(), true) != published.end();
+    }
+};
+
+#endif //PANDEMIC_HOYA_2002_SYNCHRONOUS_RUNNER_HPP
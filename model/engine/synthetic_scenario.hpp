@@ -0,0 +1,300 @@
+//
+// Generates scenarios of any size with the structure of the geographical scenarios, to measure how the model scales.
+//
+
+#ifndef PANDEMIC_HOYA_2002_SYNTHETIC_SCENARIO_HPP
+#define PANDEMIC_HOYA_2002_SYNTHETIC_SCENARIO_HPP
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <limits>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "../cells/vicinity.hpp"
+#include "cell_id_table.hpp"
+#include "compiled_scenario.hpp"
+#include "scenario_loader.hpp"
+
+// The regions of a synthetic scenario tile a plane, as dissemination areas do. The plane is a grid of unit squares,
+// and the regions are blocks of k x k squares placed row by row where the squares are free: most are single squares,
+// and a few are larger, as the rural areas of a census division. Two regions are neighbors when they share a side of
+// a square, or (as in a triangulation) one of the two diagonals of a corner where four regions meet. Single squares
+// then have 4 to 8 neighbors, and the larger regions up to about 30, so that the degrees are distributed about as those
+// of the Ottawa DAs (mean 6, mostly 4 to 8, a few regions with more than 15 neighbors; the DAs have a mean of 6.3).
+//
+// Every side of a square has a random length around 1 and every diagonal contact a short one; the shared boundary of
+// two regions and the boundary of every region are the sums of these lengths, from which the correlations are computed
+// as scenario_builder computes them from the boundaries of real regions. The populations are log-normal around the
+// population of a DA. Everything is drawn from the seed, so a size and a seed always give the same scenario (with the
+// same standard library).
+//
+// Cells are identified by their index, zero-padded to the same width so that the IDs are sorted as the indices.
+class synthetic_scenario {
+public:
+    synthetic_scenario(cell_index num_cells, std::uint64_t seed = 1) : random{seed} {
+        if(num_cells == 0) {
+            throw std::invalid_argument{"A synthetic scenario needs at least one cell"};
+        }
+        id_width = std::to_string(num_cells - 1).size();
+        place_regions(num_cells);
+        connect_regions(num_cells);
+
+        std::lognormal_distribution<double> population{std::log(600.0), 0.4};
+        populations.resize(num_cells);
+        for(auto &cell_population : populations) {
+            cell_population = std::round(population(random));
+        }
+    }
+
+    cell_index get_num_cells() const {
+        return populations.size();
+    }
+
+    // The number of (directed) neighbor relations, without the cells themselves.
+    std::size_t get_num_edges() const {
+        return neighbors.size();
+    }
+
+    unsigned int get_max_degree() const {
+        unsigned int max_degree = 0;
+        for(cell_index i = 0; i < get_num_cells(); ++i) {
+            max_degree = std::max<unsigned int>(max_degree, offsets[i + 1] - offsets[i]);
+        }
+        return max_degree;
+    }
+
+    std::string cell_id(cell_index i) const {
+        std::string id = std::to_string(i);
+        return std::string(id_width - id.size(), '0') + id;
+    }
+
+    // Writes the regions and the adjacency (with the boundary lengths) in the form of the cadmium_gis files, from which
+    // pandemic-scenario-builder builds the JSON form of the same scenario.
+    void write_csv(std::string const &regions_path, std::string const &adjacency_path) const {
+        std::ofstream regions = open(regions_path);
+        regions << "DAuid,DApop_2016\n";
+        for(cell_index i = 0; i < get_num_cells(); ++i) {
+            regions << cell_id(i) << "," << populations[i] << "\n";
+        }
+
+        std::ofstream adjacency = open(adjacency_path);
+        adjacency.precision(std::numeric_limits<double>::max_digits10);
+        adjacency << "dauid,Neighbor_dauid,region_boundary,neighbor_boundary,shared_boundary\n";
+        for(cell_index i = 0; i < get_num_cells(); ++i) {
+            for(auto edge = offsets[i]; edge < offsets[i + 1]; ++edge) {
+                adjacency << cell_id(i) << "," << cell_id(neighbors[edge]) << "," << boundaries[i] << ","
+                          << boundaries[neighbors[edge]] << "," << shared_boundaries[edge] << "\n";
+            }
+        }
+        if(!regions || !adjacency) {
+            throw std::runtime_error{"Unable to write " + regions_path + " or " + adjacency_path};
+        }
+    }
+
+    // Writes the compiled form of the scenario, with the cells of an input folder of Scripts/Input_Generator: every
+    // cell is default_cell with the population of its region, and num_infected cells spread over the indices have the
+    // compartments of infected_state. The cells are written one by one, so the definitions of the scenario never exist
+    // all at once.
+    void write_compiled(std::string const &file_path, nlohmann::json const &default_cell, std::vector<std::string> fields,
+                        nlohmann::json const &infected_state, cell_index num_infected = 1) const {
+        nlohmann::json infected_cell = default_cell;
+        for(auto const &compartment : infected_state.items()) {
+            infected_cell["state"][compartment.key()] = compartment.value();
+        }
+        cell_definition const healthy = scenario_loader::parse_cell("", default_cell);
+        cell_definition const infected = scenario_loader::parse_cell("", infected_cell);
+        vicinity const default_vicinity = default_cell.at("neighborhood").at("default_cell_id").get<vicinity>();
+
+        cell_id_table cell_ids;
+        for(cell_index i = 0; i < get_num_cells(); ++i) {
+            cell_ids.intern(cell_id(i));
+        }
+        compiled_scenario::writer out{std::move(fields), std::move(cell_ids)};
+
+        num_infected = std::min(num_infected, get_num_cells());
+        cell_index next_infected = 0;
+        for(cell_index i = 0; i < get_num_cells(); ++i) {
+            // The k-th infected cell is in the middle of the k-th of num_infected equal ranges of indices.
+            bool is_infected = next_infected < num_infected &&
+                               i == (2 * static_cast<std::uint64_t>(next_infected) + 1) * get_num_cells() / (2 * num_infected);
+            next_infected += is_infected;
+
+            cell_definition definition = is_infected ? infected : healthy;
+            definition.cell_id = cell_id(i);
+            definition.initial_state.population = populations[i];
+            definition.neighborhood.insert({definition.cell_id, default_vicinity});
+            for(auto edge = offsets[i]; edge < offsets[i + 1]; ++edge) {
+                vicinity edge_vicinity = default_vicinity;
+                edge_vicinity.correlation = (shared_boundaries[edge] / boundaries[i] +
+                                             shared_boundaries[edge] / boundaries[neighbors[edge]]) / 2;
+                definition.neighborhood.insert({cell_id(neighbors[edge]), std::move(edge_vicinity)});
+            }
+            out.add(definition);
+        }
+
+        std::string source = "synthetic " + std::to_string(get_num_cells()) + " " + std::to_string(num_infected) + " " +
+                             default_cell.dump() + infected_state.dump();
+        std::uint64_t source_hash = compiled_scenario::hash_bytes(source.data(), source.size());
+        source_hash = compiled_scenario::hash_bytes(reinterpret_cast<const char *>(populations.data()),
+                                                    populations.size() * sizeof(double), source_hash);
+        source_hash = compiled_scenario::hash_bytes(reinterpret_cast<const char *>(shared_boundaries.data()),
+                                                    shared_boundaries.size() * sizeof(double), source_hash);
+        out.write(file_path, source_hash);
+    }
+
+private:
+    static constexpr cell_index no_region = std::numeric_limits<cell_index>::max();
+
+    std::mt19937_64 random;
+    std::size_t id_width;
+
+    // The region of every square of the grid, row by row; no_region outside of the regions.
+    unsigned long width = 0;
+    std::vector<cell_index> squares;
+
+    std::vector<double> populations;
+    std::vector<double> boundaries;
+    // The neighbors of cell i are neighbors[offsets[i]] to neighbors[offsets[i + 1] - 1], sorted by index.
+    std::vector<std::size_t> offsets;
+    std::vector<cell_index> neighbors;
+    std::vector<double> shared_boundaries;
+
+    static std::ofstream open(std::string const &file_path) {
+        std::ofstream file{file_path};
+        if(!file.is_open()) {
+            throw std::runtime_error{"Unable to open the file: " + file_path};
+        }
+        return file;
+    }
+
+    cell_index square(long row, long column) const {
+        if(row < 0 || column < 0 || column >= static_cast<long>(width) ||
+           static_cast<std::size_t>(row) * width + column >= squares.size()) {
+            return no_region;
+        }
+        return squares[row * width + column];
+    }
+
+    void place_regions(cell_index num_cells) {
+        // The sizes of the blocks and their probabilities. A square of the grid is 1.3 squares on average.
+        constexpr std::array<unsigned long, 5> block_sizes = {1, 2, 3, 4, 6};
+        std::discrete_distribution<unsigned int> block_size{915, 60, 15, 8, 2};
+        width = std::max(1ul, static_cast<unsigned long>(std::ceil(std::sqrt(1.3 * num_cells))));
+
+        cell_index num_regions = 0;
+        for(std::size_t position = 0; num_regions < num_cells; ++position) {
+            if(position >= squares.size()) {
+                squares.resize(squares.size() + width, no_region);
+            }
+            if(squares[position] != no_region) {
+                continue;
+            }
+            long row = position / width;
+            long column = position % width;
+            unsigned long size = block_sizes[block_size(random)];
+            while(size > 1 && !block_fits(row, column, size)) {
+                --size;
+            }
+            squares.resize(std::max(squares.size(), (row + size) * width), no_region);
+            for(unsigned long r = 0; r < size; ++r) {
+                for(unsigned long c = 0; c < size; ++c) {
+                    squares[(row + r) * width + column + c] = num_regions;
+                }
+            }
+            ++num_regions;
+        }
+    }
+
+    bool block_fits(long row, long column, unsigned long size) const {
+        if(column + size > width) {
+            return false;
+        }
+        for(unsigned long r = 0; r < size; ++r) {
+            for(unsigned long c = 0; c < size; ++c) {
+                std::size_t position = (row + r) * width + column + c;
+                if(position < squares.size() && squares[position] != no_region) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    void connect_regions(cell_index num_cells) {
+        std::vector<std::vector<std::pair<cell_index, double>>> contacts(num_cells);
+        boundaries.assign(num_cells, 0);
+
+        auto add_boundary = [&](cell_index a, cell_index b, double length) {
+            if(a == b) {
+                return;
+            }
+            for(auto [region, neighbor] : {std::make_pair(a, b), std::make_pair(b, a)}) {
+                if(region == no_region) {
+                    continue;
+                }
+                boundaries[region] += length;
+                if(neighbor == no_region) {
+                    continue;
+                }
+                auto &region_contacts = contacts[region];
+                auto contact = std::find_if(region_contacts.begin(), region_contacts.end(),
+                                            [neighbor](auto const &c) { return c.first == neighbor; });
+                if(contact == region_contacts.end()) {
+                    region_contacts.emplace_back(neighbor, length);
+                } else {
+                    contact->second += length;
+                }
+            }
+        };
+
+        std::uniform_real_distribution<double> side_length{0.7, 1.3};
+        std::uniform_real_distribution<double> diagonal_length{0.02, 0.3};
+        std::bernoulli_distribution first_diagonal{0.5};
+        long num_rows = squares.size() / width;
+        for(long row = -1; row < num_rows; ++row) {
+            for(long column = -1; column < static_cast<long>(width); ++column) {
+                cell_index current = square(row, column);
+                cell_index right = square(row, column + 1);
+                cell_index below = square(row + 1, column);
+                cell_index below_right = square(row + 1, column + 1);
+                if(current != right) {
+                    add_boundary(current, right, side_length(random));
+                }
+                if(current != below) {
+                    add_boundary(current, below, side_length(random));
+                }
+                bool corner = current != no_region && right != no_region && below != no_region && below_right != no_region &&
+                              current != right && current != below && current != below_right && right != below &&
+                              right != below_right && below != below_right;
+                if(corner) {
+                    if(first_diagonal(random)) {
+                        add_boundary(current, below_right, diagonal_length(random));
+                    } else {
+                        add_boundary(right, below, diagonal_length(random));
+                    }
+                }
+            }
+        }
+        squares = {};
+
+        offsets.assign(1, 0);
+        for(auto &region_contacts : contacts) {
+            std::sort(region_contacts.begin(), region_contacts.end());
+            for(auto const &contact : region_contacts) {
+                neighbors.push_back(contact.first);
+                shared_boundaries.push_back(contact.second);
+            }
+            offsets.push_back(neighbors.size());
+            region_contacts = {};
+        }
+    }
+};
+
+#endif //PANDEMIC_HOYA_2002_SYNTHETIC_SCENARIO_HPP
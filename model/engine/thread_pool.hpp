@@ -0,0 +1,162 @@
+//
+// Fixed-size thread pool with work stealing, used to evaluate the cells of a time step in parallel.
+//
+
+#ifndef PANDEMIC_HOYA_2002_THREAD_POOL_HPP
+#define PANDEMIC_HOYA_2002_THREAD_POOL_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// parallel_for splits the index range in one contiguous share per thread. Each thread claims chunks of its own share
+// through an atomic cursor and, once its share is exhausted, steals chunks from the shares of the other threads.
+// Cells differ a lot in cost (their degree ranges from 1 to dozens of neighbors), so stealing keeps every thread busy
+// without a central queue. Which thread runs an index never changes what the body computes for it.
+class thread_pool {
+public:
+    // num_threads includes the thread calling parallel_for; 1 runs everything on the calling thread.
+    explicit thread_pool(unsigned int num_threads, unsigned int chunk_size = 16) :
+            num_threads{std::max(1u, num_threads)}, chunk_size{std::max(1u, chunk_size)}, shares(this->num_threads) {
+        for(unsigned int i = 1; i < this->num_threads; ++i) {
+            workers.emplace_back([this, i]() { worker_loop(i); });
+        }
+    }
+
+    thread_pool(const thread_pool &) = delete;
+    thread_pool &operator=(const thread_pool &) = delete;
+
+    ~thread_pool() {
+        {
+            std::lock_guard<std::mutex> lock{mutex};
+            stopping = true;
+        }
+        job_available.notify_all();
+        for(auto &worker : workers) {
+            worker.join();
+        }
+    }
+
+    // The most threads a pool is meant to have: beyond a few per hardware thread, more threads only add switches, and
+    // every thread has its own share of the work.
+    static unsigned int max_threads() {
+        return 4 * std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    unsigned int get_num_threads() const {
+        return num_threads;
+    }
+
+    // Calls body(i) for every i in [0, count) and returns once all the calls are done. If a call throws, the remaining
+    // chunks are skipped and the first exception is rethrown here.
+    void parallel_for(unsigned int count, const std::function<void(unsigned int)> &body) {
+        if(num_threads == 1 || count <= chunk_size) {
+            for(unsigned int i = 0; i < count; ++i) {
+                body(i);
+            }
+            return;
+        }
+
+        unsigned int share_size = (count + num_threads - 1) / num_threads;
+        for(unsigned int i = 0; i < num_threads; ++i) {
+            shares[i].next.store(std::min(count, i * share_size), std::memory_order_relaxed);
+            shares[i].end = std::min(count, (i + 1) * share_size);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock{mutex};
+            job = &body;
+            first_exception = nullptr;
+            failed.store(false, std::memory_order_relaxed);
+            busy_workers = num_threads - 1;
+            ++generation;
+        }
+        job_available.notify_all();
+
+        run_shares(0);
+
+        std::unique_lock<std::mutex> lock{mutex};
+        job_done.wait(lock, [this]() { return busy_workers == 0; });
+        job = nullptr;
+
+        if(first_exception) {
+            std::rethrow_exception(first_exception);
+        }
+    }
+
+private:
+    struct alignas(64) share {
+        std::atomic<unsigned int> next{0};
+        unsigned int end = 0;
+    };
+
+    unsigned int num_threads;
+    unsigned int chunk_size;
+    std::vector<share> shares;
+    std::vector<std::thread> workers;
+
+    std::mutex mutex;
+    std::condition_variable job_available;
+    std::condition_variable job_done;
+    const std::function<void(unsigned int)> *job = nullptr;
+    std::exception_ptr first_exception;
+    std::atomic<bool> failed{false};
+    unsigned int busy_workers = 0;
+    unsigned long generation = 0;
+    bool stopping = false;
+
+    void worker_loop(unsigned int thread_index) {
+        unsigned long seen_generation = 0;
+        while(true) {
+            {
+                std::unique_lock<std::mutex> lock{mutex};
+                job_available.wait(lock, [&]() { return stopping || generation != seen_generation; });
+                if(stopping) {
+                    return;
+                }
+                seen_generation = generation;
+            }
+
+            run_shares(thread_index);
+
+            {
+                std::lock_guard<std::mutex> lock{mutex};
+                --busy_workers;
+            }
+            job_done.notify_one();
+        }
+    }
+
+    // Drains the thread's own share first, then the shares of the other threads in round-robin order.
+    void run_shares(unsigned int thread_index) {
+        for(unsigned int offset = 0; offset < num_threads; ++offset) {
+            share &current = shares[(thread_index + offset) % num_threads];
+            while(!failed.load(std::memory_order_relaxed)) {
+                unsigned int begin = current.next.fetch_add(chunk_size, std::memory_order_relaxed);
+                if(begin >= current.end) {
+                    break;
+                }
+                unsigned int end = std::min(current.end, begin + chunk_size);
+                try {
+                    for(unsigned int i = begin; i < end; ++i) {
+                        (*job)(i);
+                    }
+                } catch(...) {
+                    std::lock_guard<std::mutex> lock{mutex};
+                    if(!first_exception) {
+                        first_exception = std::current_exception();
+                    }
+                    failed.store(true, std::memory_order_relaxed);
+                }
+            }
+        }
+    }
+};
+
+#endif //PANDEMIC_HOYA_2002_THREAD_POOL_HPP
@@ -5,9 +5,14 @@
 #ifndef PANDEMIC_HOYA_2002_ZHONG_COUPLED_HPP
 #define PANDEMIC_HOYA_2002_ZHONG_COUPLED_HPP
 
+#include <ostream>
+#include <vector>
 #include <nlohmann/json.hpp>
 #include <cadmium/celldevs/coupled/cells_coupled.hpp>
 #include "cells/geographical_cell.hpp"
+#include "engine/compiled_scenario.hpp"
+#include "engine/config_pool.hpp"
+#include "engine/scenario_loader.hpp"
 
 template <typename T>
 class geographical_coupled : public cadmium::celldevs::cells_coupled<T, std::string, seaird, vicinity>
@@ -20,6 +25,31 @@ class geographical_coupled : public cadmium::celldevs::cells_coupled<T, std::str
         template<typename X>
         using cell_unordered = std::unordered_map<std::string, X>;
 
+        // Same cells, in the same order, as cells_coupled::add_cells_json, but the scenario is streamed instead of
+        // being loaded as a whole (see engine/scenario_loader.hpp).
+        void add_cells_json(std::string const &file_in, unsigned int num_threads = 1)
+        {
+            thread_pool pool{num_threads};
+            add_cells(scenario_loader::load(file_in, pool));
+        }
+
+        // Loads the cells of a scenario compiled by compiled_scenario::compile (see engine/compiled_scenario.hpp).
+        void add_cells_compiled(std::string const &file_in)
+        {
+            add_cells(compiled_scenario::read(file_in).cells);
+        }
+
+        void add_cells(std::vector<cell_definition> definitions)
+        {
+            for (auto &definition : definitions)
+            {
+                if (definition.cell_type != "zhong") throw std::bad_typeid();
+                this->template add_cell<geographical_cell>(definition.cell_id, definition.neighborhood,
+                                                           definition.initial_state, definition.delay_id,
+                                                           configs.intern(std::move(definition.config)));
+            }
+        }
+
         void add_cell_json(std::string const &cell_type, std::string const &cell_id,
                            cell_unordered<vicinity> const &neighborhood,
                            seaird initial_state,
@@ -28,10 +58,54 @@ class geographical_coupled : public cadmium::celldevs::cells_coupled<T, std::str
         {
             if (cell_type == "zhong")
             {
-                auto conf = config.get<typename geographical_cell<T>::config_type>();
+                auto conf = configs.intern(config.get<typename geographical_cell<T>::config_type>());
                 this->template add_cell<geographical_cell>(cell_id, neighborhood, initial_state, delay_id, conf);
             } else throw std::bad_typeid();
         }
+
+#ifdef PANDEMIC_HOT_PATH_COUNTERS
+        // The counters of the hot path (see cells/hot_path_counters.hpp) summed over the cells. The cells are the atomic
+        // models of this coupled model, which the simulators of Cadmium's runner share, so these are the counters of
+        // the run so far. Cadmium routes the messages itself, so none are counted as routed.
+        hot_path_counters total_hot_path_counters() const
+        {
+            hot_path_counters total;
+            for (auto const *cell : cells())
+            {
+                total += cell->counters;
+            }
+            return total;
+        }
+
+        // Writes the counters of every cell as CSV, as synchronous_runner::write_hot_path_counters does.
+        void write_hot_path_counters(std::ostream &cells_counters) const
+        {
+            hot_path_counters::write_csv_header(cells_counters << "cell_id,neighbors,") << "\n";
+            for (auto const *cell : cells())
+            {
+                cell->counters.write_csv(cells_counters << cell->cell_id << "," << cell->neighbors.size() << ",") << "\n";
+            }
+        }
+#endif
+
+    private:
+        // The configurations of the cells; cells with equal configurations share one (see engine/config_pool.hpp).
+        config_pool configs;
+
+#ifdef PANDEMIC_HOT_PATH_COUNTERS
+        std::vector<geographical_cell<T> const *> cells() const
+        {
+            std::vector<geographical_cell<T> const *> result;
+            for (auto const &model : this->_models)
+            {
+                if (auto const *cell = dynamic_cast<geographical_cell<T> const *>(model.get()))
+                {
+                    result.push_back(cell);
+                }
+            }
+            return result;
+        }
+#endif
 };
 
 #endif //PANDEMIC_HOYA_2002_ZHONG_COUPLED_HPP
@@ -0,0 +1,50 @@
+// Converts a binary log written with --log-format=binary into the text message and state logs of main.cpp, or into a
+// CSV time series of every cell (the only conversion available for the delta logs written with --log-delta).
+
+#include <fstream>
+#include <iostream>
+#include <string>
+#include "../model/engine/binary_log.hpp"
+
+using TIME = float;
+
+int main(int argc, char ** argv) {
+    bool to_csv = argc == 4 && std::string{argv[2]} == "--csv";
+    if (argc != 2 && argc != 4) {
+        std::cout << "Program used with wrong parameters. The program must be invoked as follows:";
+        std::cout << argv[0] << " BINARY_LOG [MESSAGES_LOG STATE_LOG]" << std::endl;
+        std::cout << "The text logs default to ../logs/pandemic_messages.txt and ../logs/pandemic_state.txt" << std::endl;
+        std::cout << "or: " << argv[0] << " BINARY_LOG --csv TIME_SERIES.csv" << std::endl;
+        return -1;
+    }
+
+    try {
+        binary_log::reader log{argv[1]};
+
+        if(to_csv) {
+            std::ofstream csv{argv[3]};
+            if(!csv.is_open()) {
+                throw std::runtime_error{"Unable to open the file: " + std::string{argv[3]}};
+            }
+            binary_log::convert_to_csv(log, csv);
+            return 0;
+        }
+
+        std::string messages_path = argc == 4 ? argv[2] : "../logs/pandemic_messages.txt";
+        std::string state_path = argc == 4 ? argv[3] : "../logs/pandemic_state.txt";
+
+        std::ofstream messages_log{messages_path};
+        std::ofstream state_log{state_path};
+        if(!messages_log.is_open() || !state_log.is_open()) {
+            throw std::runtime_error{"Unable to open the text logs for writing"};
+        }
+
+        binary_log::convert_to_text<TIME>(log, messages_log, state_log);
+    }
+    catch(std::exception &e) {
+        std::cerr << "A fatal error occurred: " << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -28,11 +28,23 @@
  // Modified by Glenn 02/07/20
  // changed message log file to be called pandemic_messages.txt
 
+#include <algorithm>
+#include <cstdlib>
 #include <fstream>
+#include <optional>
 #include <cadmium/modeling/dynamic_coupled.hpp>
 #include <cadmium/engine/pdevs_dynamic_runner.hpp>
 #include <cadmium/logger/common_loggers.hpp>
 #include "../model/geographical_coupled.hpp"
+#include "../model/engine/aggregate_reporter.hpp"
+#include "../model/engine/async_log_sink.hpp"
+#include "../model/engine/binary_log.hpp"
+#include "../model/engine/command_line.hpp"
+#include "../model/engine/compiled_scenario.hpp"
+#include "../model/engine/gis_viewer_writer.hpp"
+#include "../model/engine/parameter_sweep.hpp"
+#include "../model/engine/run_report.hpp"
+#include "../model/engine/synchronous_runner.hpp"
 
 using namespace std;
 using namespace cadmium;
@@ -61,16 +73,191 @@ using global_time_sta=logger::logger<logger::logger_global_time, dynamic::logger
 
 using logger_top=logger::multilogger<state, log_messages, global_time_mes, global_time_sta>;
 
+// The output of a variant of a sweep: its name is inserted before the extension of the path.
+std::string variant_path(std::string const &path, std::string const &variant) {
+    auto extension = path.find_last_of('.');
+    if(extension == std::string::npos || extension < path.find_last_of('/') + 1) {
+        return path + "_" + variant;
+    }
+    return path.substr(0, extension) + "_" + variant + path.substr(extension);
+}
+
+// Runs every variant of a sweep specification (see model/engine/parameter_sweep.hpp) on the cells of the scenario.
+// Every variant has its own logs and report, labeled with its name. With a fork time, the scenario itself runs up to
+// that time first, with the logs and the report of a normal run, and the variants are branches from there on.
+void run_sweep(std::string const &sweep_path, std::vector<cell_definition> const &definitions, float sim_time,
+               std::optional<float> fork_time, unsigned int num_threads, std::string const &log_format,
+               std::optional<double> log_delta, std::string const &report_path, std::string const &report_regions_path) {
+    auto regions = report_regions_path.empty() ? aggregate_reporter<TIME>::region_map{}
+                                               : aggregate_reporter<TIME>::read_regions(report_regions_path);
+
+    std::vector<std::unique_ptr<std::ofstream>> files;
+    std::vector<std::unique_ptr<log_sink<TIME>>> owned_sinks;
+    std::vector<std::unique_ptr<log_sink_group<TIME>>> groups;
+    auto open = [&files](std::string const &path) -> std::ofstream & {
+        files.push_back(std::make_unique<std::ofstream>(path));
+        if(!files.back()->is_open()) {
+            throw std::runtime_error{"Unable to open the file: " + path};
+        }
+        return *files.back();
+    };
+    // The logs and report of a run; those of a variant are labeled with its name.
+    auto outputs = [&](std::string const &variant,
+                       std::vector<std::unique_ptr<geographical_cell<TIME>>> const &cells) -> log_sink<TIME> * {
+        auto path = [&variant](std::string const &path) { return variant.empty() ? path : variant_path(path, variant); };
+        groups.push_back(std::make_unique<log_sink_group<TIME>>());
+        if(log_format == "binary") {
+            owned_sinks.push_back(std::make_unique<binary_log::writer<TIME>>(path("../logs/pandemic_log.bin"), log_delta));
+        } else if(variant.empty()) {
+            owned_sinks.push_back(std::make_unique<text_log_sink<TIME>>(out_messages, out_state));
+        } else {
+            std::ofstream &messages = open(path("../logs/pandemic_messages.txt"));
+            std::ofstream &states = open(path("../logs/pandemic_state.txt"));
+            owned_sinks.push_back(std::make_unique<text_log_sink<TIME>>(messages, states));
+        }
+        groups.back()->add(*owned_sinks.back());
+
+        if(!report_path.empty()) {
+            std::vector<double> populations;
+            for(auto const &cell : cells) {
+                populations.push_back(cell->state.current_state.population);
+            }
+            std::ofstream &report = open(path(report_path));
+            owned_sinks.push_back(std::make_unique<aggregate_reporter<TIME>>(report, std::move(populations), regions));
+            groups.back()->add(*owned_sinks.back());
+        }
+        return groups.back().get();
+    };
+
+    std::unique_ptr<parameter_sweep<TIME>> sweep;
+    auto variants = parameter_sweep<TIME>::read_variants(sweep_path);
+    if(fork_time) {
+        synchronous_runner<TIME> baseline;
+        baseline.set_num_threads(num_threads);
+        for(auto const &definition : definitions) {
+            baseline.add_cell(definition);
+        }
+        baseline.couple_cells();
+        baseline.run_until(*fork_time, *outputs("", baseline.get_cells()));
+        sweep = std::make_unique<parameter_sweep<TIME>>(definitions, std::move(variants), baseline, num_threads);
+    } else {
+        sweep = std::make_unique<parameter_sweep<TIME>>(definitions, std::move(variants), num_threads);
+    }
+
+    std::vector<std::string> names = sweep->get_names();
+    std::vector<log_sink<TIME> *> sinks;
+    for(unsigned int l = 0; l < names.size(); ++l) {
+        sinks.push_back(outputs(names[l], sweep->get_cells()));
+    }
+    sweep->run_until(sim_time, sinks);
+}
+
+
+int print_usage(char const *program) {
+    cout << "Program used with wrong parameters. The program must be invoked as follows:";
+    cout << program << " SCENARIO_CONFIG.json [MAX_SIMULATION_TIME (default: 500)] [--engine=cadmium|synchronous] [--threads=N]"
+         << " [--log-format=text|binary] [--log-delta=EPSILON] [--async-log] [--report=AGGREGATES.csv"
+         << " [--report-regions=CELL_REGIONS.csv]] [--gis-viewer=DIRECTORY] [--scenario-cache=DIRECTORY]"
+         << " [--sweep=SWEEP.json [--fork-at=DAY]] [--checkpoint-every=DAYS] [--resume=CHECKPOINT.bin] [--run-report]"
+         << endl;
+    return -1;
+}
 
 int main(int argc, char ** argv) {
     if (argc < 2) {
-        cout << "Program used with wrong parameters. The program must be invoked as follows:";
-        cout << argv[0] << " SCENARIO_CONFIG.json [MAX_SIMULATION_TIME (default: 500)]" << endl;
-        return -1;
+        return print_usage(argv[0]);
     }
 
+    // The synchronous engine produces the same logs as Cadmium's runner, but advances all the cells of a time step
+    // together over arrays (see model/engine/synchronous_runner.hpp).
+    std::string engine = "cadmium";
+    std::string log_format = "text";
+    bool async_log = false;
+    std::optional<double> log_delta;
+    std::string report_path;
+    std::string report_regions_path;
+    std::string gis_viewer_directory;
+    std::string scenario_cache_directory;
+    std::string sweep_path;
+    std::optional<float> fork_time;
+    float checkpoint_interval = 0;
+    std::string resume_path;
+    std::optional<run_report> run_stats;
+    unsigned int num_threads = 1;
+    float sim_time = 500;
+
     try {
-        
+        for(int i = 2; i < argc; ++i) {
+            std::string argument = argv[i];
+            // Whether the value of a numeric option is a number.
+            bool valid = true;
+            if(argument.rfind("--engine=", 0) == 0) {
+                engine = argument.substr(std::string{"--engine="}.size());
+            } else if(argument.rfind("--log-format=", 0) == 0) {
+                log_format = argument.substr(std::string{"--log-format="}.size());
+            } else if(argument.rfind("--log-delta=", 0) == 0) {
+                valid = command_line::parse_option(argument, log_delta);
+            } else if(argument.rfind("--report=", 0) == 0) {
+                report_path = argument.substr(std::string{"--report="}.size());
+            } else if(argument.rfind("--report-regions=", 0) == 0) {
+                report_regions_path = argument.substr(std::string{"--report-regions="}.size());
+            } else if(argument.rfind("--gis-viewer=", 0) == 0) {
+                gis_viewer_directory = argument.substr(std::string{"--gis-viewer="}.size());
+            } else if(argument.rfind("--scenario-cache=", 0) == 0) {
+                scenario_cache_directory = argument.substr(std::string{"--scenario-cache="}.size());
+            } else if(argument.rfind("--sweep=", 0) == 0) {
+                sweep_path = argument.substr(std::string{"--sweep="}.size());
+            } else if(argument.rfind("--fork-at=", 0) == 0) {
+                valid = command_line::parse_option(argument, fork_time);
+            } else if(argument.rfind("--checkpoint-every=", 0) == 0) {
+                valid = command_line::parse_option(argument, checkpoint_interval);
+            } else if(argument.rfind("--resume=", 0) == 0) {
+                resume_path = argument.substr(std::string{"--resume="}.size());
+            } else if(argument == "--async-log") {
+                async_log = true;
+            } else if(argument == "--run-report") {
+                run_stats.emplace();
+            } else if(argument.rfind("--threads=", 0) == 0) {
+                if(!command_line::parse_num_threads(argument, num_threads)) {
+                    cerr << command_line::num_threads_error(argument) << endl;
+                    return print_usage(argv[0]);
+                }
+            } else {
+                // Anything else is the simulation time, which must be a number: a misspelled option must not become a
+                // simulation time of 0.
+                std::optional<float> time;
+                if(argument.rfind("--", 0) != 0) {
+                    time = command_line::parse_number<float>(argument);
+                }
+                if(!time) {
+                    cerr << "Unknown argument: " << argument << endl;
+                    return print_usage(argv[0]);
+                }
+                sim_time = *time;
+            }
+            if(!valid) {
+                cerr << "Invalid value: " << argument << " (expected a number)" << endl;
+                return print_usage(argv[0]);
+            }
+        }
+
+        // With --run-report, the wall time, CPU time and peak memory of every stage of the run and the time of every
+        // day are printed to stderr at the end of the run and written to logs/pandemic_run_report.json.
+        auto begin_stage = [&run_stats](std::string const &name) {
+            if(run_stats) {
+                run_stats->begin_stage(name);
+            }
+        };
+        auto finish_report = [&run_stats]() {
+            if(run_stats) {
+                run_stats->end_stage();
+                run_stats->print(std::cerr);
+                run_stats->write_json("../logs/pandemic_run_report.json");
+            }
+        };
+
+        begin_stage("check");
+
         // The C++ standard filesystem library is not used as it may require an additional linker flag (-std=c++17),
         // but more importantly that in certain versions of GCC the filesystem is contained in an experimental folder (GCC 7).
         // Newer versions of GCC doesn't have this problem (apparently GCC 8+ ?). As a result, depending on the version of GCC
@@ -84,20 +271,209 @@ int main(int argc, char ** argv) {
             throw std::runtime_error{"Unable to open the file: " + std::string{argv[1]}};
         }
 
+        std::string scenario_config_file_path = argv[1];
+
+        // A compiled scenario (see model/engine/compiled_scenario.hpp) is loaded without parsing any JSON. With a cache
+        // directory, a JSON scenario is compiled there on its first run and its compiled form is used afterwards.
+        if(!scenario_cache_directory.empty() && !compiled_scenario::is_compiled(scenario_config_file_path)) {
+            scenario_config_file_path = compiled_scenario::load_cached(scenario_config_file_path, scenario_cache_directory,
+                                                                       num_threads);
+        }
+        bool compiled = compiled_scenario::is_compiled(scenario_config_file_path);
+
+        if(fork_time && sweep_path.empty()) {
+            throw std::invalid_argument{"--fork-at requires --sweep"};
+        }
+        if(!sweep_path.empty()) {
+            // The scenario is loaded once and its variants run together; each one logs as a run of its own would.
+            if(engine != "synchronous") {
+                throw std::invalid_argument{"--sweep requires --engine=synchronous"};
+            } else if(async_log || !gis_viewer_directory.empty() || checkpoint_interval > 0 || !resume_path.empty()) {
+                throw std::invalid_argument{"--async-log, --gis-viewer, --checkpoint-every and --resume cannot be used with --sweep"};
+            } else if(log_format != "text" && log_format != "binary") {
+                throw std::invalid_argument{"Unknown log format: " + log_format + " (expected text or binary)"};
+            } else if(log_delta && log_format != "binary") {
+                throw std::invalid_argument{"--log-delta requires --log-format=binary"};
+            } else if(!report_regions_path.empty() && report_path.empty()) {
+                throw std::invalid_argument{"--report-regions requires --report"};
+            }
+            begin_stage("load");
+            std::vector<cell_definition> definitions;
+            if(compiled) {
+                definitions = compiled_scenario::read(scenario_config_file_path).cells;
+            } else {
+                thread_pool pool{num_threads};
+                definitions = scenario_loader::load(scenario_config_file_path, pool);
+            }
+            begin_stage("run");
+            run_sweep(sweep_path, definitions, sim_time, fork_time, num_threads, log_format, log_delta, report_path,
+                      report_regions_path);
+            finish_report();
+            return 0;
+        }
+
+        if(engine == "synchronous") {
+            begin_stage("load");
+            synchronous_runner<TIME> runner;
+            runner.set_num_threads(num_threads);
+            if(compiled) {
+                runner.add_cells_compiled(scenario_config_file_path);
+            } else {
+                runner.add_cells_json(scenario_config_file_path);
+            }
+            begin_stage("couple");
+            runner.couple_cells();
+
+            begin_stage("setup");
+            // Checkpoints are written to logs/pandemic_checkpoint_TIME.bin. A resumed run goes on from the time of its
+            // checkpoint, up to the simulation time, and its logs start there.
+            if(checkpoint_interval > 0) {
+                runner.set_checkpoints(checkpoint_interval, "../logs/pandemic_checkpoint");
+            } else if(checkpoint_interval < 0) {
+                throw std::invalid_argument{"--checkpoint-every must be positive"};
+            }
+            if(!resume_path.empty()) {
+                runner.resume_from_checkpoint(resume_path);
+            }
+
+            std::unique_ptr<log_sink<TIME>> sink;
+            if(log_format == "binary") {
+                // Both logs in one file; pandemic-log-converter (src/log_converter.cpp) turns it back into the text logs.
+                // With --log-delta, a cell's state is only written when its values changed by more than the epsilon.
+                sink = std::make_unique<binary_log::writer<TIME>>("../logs/pandemic_log.bin", log_delta);
+            } else if(log_delta) {
+                throw std::invalid_argument{"--log-delta requires --log-format=binary"};
+            } else if(log_format == "text") {
+                sink = std::make_unique<text_log_sink<TIME>>(out_messages, out_state);
+            } else {
+                throw std::invalid_argument{"Unknown log format: " + log_format + " (expected text or binary)"};
+            }
+
+            // The daily aggregates of the domain (and of the regions, if given) are computed during the simulation.
+            log_sink_group<TIME> sinks;
+            sinks.add(*sink);
+            std::ofstream report;
+            std::unique_ptr<aggregate_reporter<TIME>> reporter;
+            if(!report_path.empty()) {
+                report.open(report_path);
+                if(!report.is_open()) {
+                    throw std::runtime_error{"Unable to open the file: " + report_path};
+                }
+                std::vector<double> populations;
+                for(auto const &cell : runner.get_cells()) {
+                    populations.push_back(cell->state.current_state.population);
+                }
+                auto regions = report_regions_path.empty() ? aggregate_reporter<TIME>::region_map{}
+                                                           : aggregate_reporter<TIME>::read_regions(report_regions_path);
+                reporter = std::make_unique<aggregate_reporter<TIME>>(report, std::move(populations), std::move(regions));
+                sinks.add(*reporter);
+            } else if(!report_regions_path.empty()) {
+                throw std::invalid_argument{"--report-regions requires --report"};
+            }
+
+            // messages.log and structure.json of the GIS viewer, without going through the message log parser.
+            std::unique_ptr<gis_viewer_writer<TIME>> gis_viewer;
+            if(!gis_viewer_directory.empty()) {
+                gis_viewer = std::make_unique<gis_viewer_writer<TIME>>(
+                        gis_viewer_directory, gis_viewer_writer<TIME>::read_fields(scenario_config_file_path),
+                        gis_viewer_writer<TIME>::read_nodes(scenario_config_file_path));
+                sinks.add(*gis_viewer);
+            }
+
+            // With --run-report, the days are timed around the sink the runner logs to.
+            auto run = [&](log_sink<TIME> &sink) {
+                begin_stage("run");
+                if(run_stats) {
+                    timed_log_sink<TIME> timed_sink{sink, *run_stats};
+                    runner.run_until(sim_time, timed_sink);
+                } else {
+                    runner.run_until(sim_time, sink);
+                }
+            };
+            if(async_log) {
+                // The logs are formatted and written by a separate thread while the simulation goes on.
+                async_log_sink<TIME> async_sink{sinks};
+                run(async_sink);
+                auto stats = async_sink.get_stats();
+                std::cout << "Asynchronous logging: " << stats.entries << " entries, the simulation waited for the writer "
+                          << stats.full_waits << " times (at most " << stats.max_pending << " entries pending)" << std::endl;
+            } else {
+                run(sinks);
+            }
+#ifdef PANDEMIC_HOT_PATH_COUNTERS
+            std::ofstream daily_counters{"../logs/pandemic_counters_days.csv"};
+            std::ofstream cell_counters{"../logs/pandemic_counters_cells.csv"};
+            runner.write_hot_path_counters(daily_counters, cell_counters);
+#endif
+            finish_report();
+            return 0;
+        } else if(engine != "cadmium") {
+            throw std::invalid_argument{"Unknown engine: " + engine + " (expected cadmium or synchronous)"};
+        } else if(num_threads != 1) {
+            throw std::invalid_argument{"--threads requires --engine=synchronous"};
+        } else if(log_format != "text" || log_delta || async_log || !report_path.empty() || !report_regions_path.empty()
+                  || !gis_viewer_directory.empty() || checkpoint_interval != 0 || !resume_path.empty()) {
+            throw std::invalid_argument{"--log-format, --log-delta, --async-log, --report, --gis-viewer, --checkpoint-every and"
+                                        " --resume require --engine=synchronous"};
+        }
+
         // Note: At the time of this writing, the web viewer that consumes the log files of this simulator relies on the
         // the input to geographical_coupled parameter (param name: id) to be empty; this changes how the IDs of cells
         // in the log files are printed.
+        begin_stage("load");
         geographical_coupled<TIME> test = geographical_coupled<TIME>("");
-        std::string scenario_config_file_path = argv[1];
-        test.add_cells_json(scenario_config_file_path);
+        if(compiled) {
+            test.add_cells_compiled(scenario_config_file_path);
+        } else {
+            test.add_cells_json(scenario_config_file_path);
+        }
+        begin_stage("couple");
         test.couple_cells();
 
-        std::shared_ptr<cadmium::dynamic::modeling::coupled < TIME>>
-        t = std::make_shared<geographical_coupled<TIME>>(test);
+        begin_stage("setup");
+        auto top_model = std::make_shared<geographical_coupled<TIME>>(test);
+        std::shared_ptr<cadmium::dynamic::modeling::coupled < TIME>> t = top_model;
 
         cadmium::dynamic::engine::runner <TIME, logger_top> r(t, {0});
-        float sim_time = (argc > 2) ? atof(argv[2]) : 500;
-        r.run_until(sim_time);
+        begin_stage("run");
+#ifdef PANDEMIC_HOT_PATH_COUNTERS
+        // The counters of a day are those the cells gained during the day.
+        std::ofstream daily_counters{"../logs/pandemic_counters_days.csv"};
+        hot_path_counters::write_csv_header(daily_counters << "time,") << "\n";
+        hot_path_counters counted;
+        auto end_day = [&](TIME day) {
+            hot_path_counters total = top_model->total_hot_path_counters();
+            (total - counted).write_csv(daily_counters << day << ",") << "\n";
+            counted = total;
+        };
+        bool step_days = true;
+#else
+        auto end_day = [](TIME) {};
+        bool step_days = run_stats.has_value();
+#endif
+        if(step_days) {
+            // The runner is advanced a day at a time to time the days and count their events; its loggers log the same
+            // as in a single call.
+            TIME next_time = 0;
+            while(next_time < sim_time) {
+                TIME day = next_time;
+                if(run_stats) {
+                    run_stats->begin_day(day, false);
+                }
+                next_time = r.run_until(std::min<TIME>(day + 1, sim_time));
+                end_day(day);
+            }
+            if(run_stats) {
+                run_stats->end_day();
+            }
+        } else {
+            r.run_until(sim_time);
+        }
+#ifdef PANDEMIC_HOT_PATH_COUNTERS
+        std::ofstream cell_counters{"../logs/pandemic_counters_cells.csv"};
+        top_model->write_hot_path_counters(cell_counters);
+#endif
+        finish_report();
     }
     catch(std::exception &e) {
         // With cygwin, an exception that terminates the program may not be printed to the screen, making it unclear
@@ -0,0 +1,278 @@
+// Measures the kernels of geographical_cell on synthetic cells shaped like those of the scenarios (5 age groups, 14
+// exposed, 12 infected and asymptomatic and 32 recovered phases) for several neighborhood sizes, and writes one CSV line
+// per kernel and neighborhood size:
+//
+//     kernel,neighbors,ns_per_cell_step,allocations_per_cell_step,cell_steps_per_second
+//
+// A cell step is what one cell does with the kernel in one time step: new_exposed, new_recoveries and new_fatalities
+// are called for every age group, movement_correction_factor for every neighbor. Every value is the median of several
+// repetitions. Scripts/Benchmark/compare_microbenchmarks.py compares two of these files (e.g. before and after a change).
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+#include "../model/cells/geographical_cell.hpp"
+#include "../model/engine/command_line.hpp"
+
+using TIME = float;
+
+// Every allocation of the process is counted, so that the allocations of a kernel are the difference of the count.
+// operator delete frees with free what operator new allocated with malloc, which GCC cannot tell.
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+static std::atomic<unsigned long> num_allocations{0};
+
+void *operator new(std::size_t size) {
+    num_allocations.fetch_add(1, std::memory_order_relaxed);
+    if(void *allocated = std::malloc(size == 0 ? 1 : size)) {
+        return allocated;
+    }
+    throw std::bad_alloc{};
+}
+
+void operator delete(void *allocated) noexcept {
+    std::free(allocated);
+}
+
+void operator delete(void *allocated, std::size_t) noexcept {
+    std::free(allocated);
+}
+
+// Keeps the results of the kernels from being optimized away.
+static volatile double result_sink = 0;
+
+struct measurement {
+    double ns_per_cell_step;
+    double allocations_per_cell_step;
+};
+
+// Runs the kernel (one cell step per call) for about min_seconds in repetitions and returns the medians.
+measurement measure(std::function<double()> const &kernel, double min_seconds) {
+    using clock = std::chrono::steady_clock;
+    constexpr unsigned int repetitions = 7;
+
+    // Calibrates the number of calls of a repetition.
+    unsigned long calls = 1;
+    while(true) {
+        auto start = clock::now();
+        for(unsigned long i = 0; i < calls; ++i) {
+            result_sink = result_sink + kernel();
+        }
+        double seconds = std::chrono::duration<double>(clock::now() - start).count();
+        if(seconds > min_seconds / repetitions / 4 || calls > (1ul << 30)) {
+            calls = std::max(1ul, static_cast<unsigned long>(calls * (min_seconds / repetitions) / std::max(seconds, 1e-9)));
+            break;
+        }
+        calls *= 4;
+    }
+
+    std::vector<double> times, allocations;
+    times.reserve(repetitions);
+    allocations.reserve(repetitions);
+    for(unsigned int r = 0; r < repetitions; ++r) {
+        unsigned long allocations_before = num_allocations.load(std::memory_order_relaxed);
+        auto start = clock::now();
+        for(unsigned long i = 0; i < calls; ++i) {
+            result_sink = result_sink + kernel();
+        }
+        double seconds = std::chrono::duration<double>(clock::now() - start).count();
+        times.push_back(seconds * 1e9 / calls);
+        allocations.push_back(static_cast<double>(num_allocations.load(std::memory_order_relaxed) - allocations_before) / calls);
+    }
+    std::sort(times.begin(), times.end());
+    std::sort(allocations.begin(), allocations.end());
+    return {times[repetitions / 2], allocations[repetitions / 2]};
+}
+
+// A cell with num_neighbors neighbors (itself included) whose states and correction factors are drawn from a fixed seed.
+struct benchmark_cell {
+    std::unique_ptr<geographical_cell<TIME>> cell;
+    std::vector<geographical_cell<TIME>::neighbor_edge> edges;
+    std::vector<hysteresis_factor> hysteresis_factors;
+    std::vector<float> neighbor_infections;
+
+    static constexpr unsigned int num_age_segments = 5;
+    static constexpr unsigned int num_exposed_phases = 14;
+    static constexpr unsigned int num_infected_phases = 12;
+    static constexpr unsigned int num_recovered_phases = 32;
+
+    explicit benchmark_cell(unsigned int num_neighbors) {
+        std::mt19937 random{num_neighbors};
+        std::uniform_real_distribution<double> uniform{0.0, 1.0};
+
+        std::unordered_map<std::string, vicinity> neighborhood;
+        for(unsigned int n = 0; n < num_neighbors; ++n) {
+            vicinity neighbor_vicinity{n == 0 ? 1.0 : uniform(random)};
+            neighbor_vicinity.set_correction_factors({{0.001f, {0.6f, 0.0008f}}, {0.005f, {0.5f, 0.003f}},
+                                                      {0.01f, {0.4f, 0.005f}}, {0.03f, {0.3f, 0.02f}},
+                                                      {0.08f, {0.2f, 0.07f}}, {0.15f, {0.05f, 0.14f}}});
+            neighborhood.insert({neighbor_id(n), neighbor_vicinity});
+        }
+
+        cell = std::make_unique<geographical_cell<TIME>>(neighbor_id(0), neighborhood, random_state(random), "inertial",
+                                                         random_config(random));
+        for(unsigned int n = 0; n < num_neighbors; ++n) {
+            seaird neighbor_state = n == 0 ? cell->state.current_state : random_state(random);
+            cell->state.neighbors_state[neighbor_id(n)] = neighbor_state;
+        }
+        for(auto const &neighbor : cell->neighbors) {
+            seaird const &neighbor_state = cell->state.neighbors_state.at(neighbor);
+            edges.push_back({&neighbor_state, &cell->state.neighbors_vicinity.at(neighbor), 0.5f});
+            neighbor_infections.push_back(neighbor_state.published_infections);
+        }
+        hysteresis_factors.assign(edges.size(), hysteresis_factor{});
+    }
+
+    static std::string neighbor_id(unsigned int n) {
+        return "cell_" + std::to_string(n);
+    }
+
+    static std::vector<double> random_values(std::mt19937 &random, unsigned int size, double scale) {
+        std::uniform_real_distribution<double> uniform{0.0, scale};
+        std::vector<double> values(size);
+        for(auto &value : values) {
+            value = uniform(random);
+        }
+        return values;
+    }
+
+    static seaird::phase_values random_phases(std::mt19937 &random, unsigned int num_phases, double scale) {
+        seaird::phase_values phases;
+        for(unsigned int age = 0; age < num_age_segments; ++age) {
+            phases.push_back(random_values(random, num_phases, scale));
+        }
+        return phases;
+    }
+
+    static seaird random_state(std::mt19937 &random) {
+        seaird state;
+        state.population = 100000;
+        state.hospital_capacity = 0.2;
+        state.fatality_modifier = 1.5;
+        state.age_group_proportions = std::make_shared<const std::vector<double>>(num_age_segments, 1.0 / num_age_segments);
+        state.disobedient = std::make_shared<const std::vector<double>>(random_values(random, num_age_segments, 0.3));
+        state.set_compartments(random_values(random, num_age_segments, 0.5), random_phases(random, num_exposed_phases, 0.01),
+                               random_phases(random, num_infected_phases, 0.01), random_phases(random, num_infected_phases, 0.01),
+                               random_phases(random, num_recovered_phases, 0.01), random_values(random, num_age_segments, 0.001));
+        state.update_published_totals();
+        return state;
+    }
+
+    static simulation_config random_config(std::mt19937 &random) {
+        simulation_config config;
+        config.prec_divider = 100000000;
+        config.virulence_rates = random_phases(random, num_infected_phases, 0.5);
+        config.incubation_rates = random_phases(random, num_exposed_phases, 0.3);
+        config.recovery_rates = random_phases(random, num_infected_phases, 0.1);
+        config.mobility_rates = random_phases(random, num_infected_phases, 1.0);
+        config.fatality_rates = random_phases(random, num_infected_phases, 0.01);
+        config.asymptomatic_rates = 0.6;
+        config.SIIRS_model = false;
+        return config;
+    }
+};
+
+int main(int argc, char ** argv) {
+    double min_seconds = 0.5;
+    std::string output_path;
+    std::vector<unsigned int> degrees = {2, 5, 10, 20, 30};
+    for(int i = 1; i < argc; ++i) {
+        std::string argument = argv[i];
+        if(argument.rfind("--min-time=", 0) == 0) {
+            if(!command_line::parse_option(argument, min_seconds) || min_seconds <= 0) {
+                std::cerr << "Invalid value: " << argument << " (expected a positive number of seconds)" << std::endl;
+                return -1;
+            }
+        } else if(argument.rfind("--output=", 0) == 0) {
+            output_path = argument.substr(std::string{"--output="}.size());
+        } else {
+            std::cout << "Program used with wrong parameters. The program must be invoked as follows:";
+            std::cout << argv[0] << " [--min-time=SECONDS_PER_KERNEL (default: 0.5)] [--output=RESULTS.csv]" << std::endl;
+            return -1;
+        }
+    }
+
+    std::ofstream output_file;
+    if(!output_path.empty()) {
+        output_file.open(output_path);
+        if(!output_file.is_open()) {
+            std::cerr << "Unable to open the file: " << output_path << std::endl;
+            return 1;
+        }
+    }
+    std::ostream &output = output_path.empty() ? std::cout : output_file;
+    output << "kernel,neighbors,ns_per_cell_step,allocations_per_cell_step,cell_steps_per_second\n";
+
+    auto report = [&output](std::string const &kernel, unsigned int num_neighbors, measurement const &result) {
+        output << kernel << "," << num_neighbors << "," << result.ns_per_cell_step << ","
+               << result.allocations_per_cell_step << "," << 1e9 / result.ns_per_cell_step << std::endl;
+    };
+
+    for(unsigned int num_neighbors : degrees) {
+        benchmark_cell bench{num_neighbors};
+        geographical_cell<TIME> const &cell = *bench.cell;
+        seaird const &current_state = cell.state.current_state;
+        unsigned int num_age_segments = current_state.get_num_age_segments();
+
+        report("local_computation", num_neighbors, measure([&]() {
+            return cell.local_computation().published_infections;
+        }, min_seconds));
+
+        report("new_exposed", num_neighbors, measure([&]() {
+            double exposed = 0;
+            for(unsigned int age = 0; age < num_age_segments; ++age) {
+                exposed += cell.new_exposed(age, 0.5f, bench.edges);
+            }
+            return exposed;
+        }, min_seconds));
+
+        report("movement_correction_factor", num_neighbors, measure([&]() {
+            double factors = 0;
+            for(unsigned int n = 0; n < bench.edges.size(); ++n) {
+                factors += cell.movement_correction_factor(bench.edges[n].neighbor_vicinity->get_correction_table(),
+                                                           bench.neighbor_infections[n], bench.hysteresis_factors[n]);
+            }
+            return factors;
+        }, min_seconds));
+
+        // The next kernels do not depend on the neighborhood; they are measured once.
+        if(num_neighbors != degrees.front()) {
+            continue;
+        }
+
+        report("new_fatalities", 0, measure([&]() {
+            double fatalities = 0;
+            for(unsigned int age = 0; age < num_age_segments; ++age) {
+                fatalities += cell.new_fatalities(current_state, age).front();
+            }
+            return fatalities;
+        }, min_seconds));
+
+        std::vector<std::vector<double>> fatalities;
+        for(unsigned int age = 0; age < num_age_segments; ++age) {
+            fatalities.push_back(cell.new_fatalities(current_state, age));
+        }
+        report("new_recoveries", 0, measure([&]() {
+            double recoveries = 0;
+            for(unsigned int age = 0; age < num_age_segments; ++age) {
+                recoveries += cell.new_recoveries(current_state, age, fatalities[age]).front();
+            }
+            return recoveries;
+        }, min_seconds));
+
+        std::vector<double> exposures(num_age_segments, 0.001);
+        report("next_state", 0, measure([&]() {
+            return cell.next_state(current_state, exposures).published_infections;
+        }, min_seconds));
+    }
+    return 0;
+}
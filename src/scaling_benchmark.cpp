@@ -0,0 +1,111 @@
+// Loads a scenario (JSON or compiled) into the synchronous engine, runs it without logging and writes one CSV line of
+// measures, so that Scripts/Benchmark/size_scaling.sh can compare scenarios of increasing size (see
+// pandemic-synthetic-scenario):
+//
+//     cells,edges,threads,days,load_seconds,couple_seconds,run_seconds,cell_steps,cell_steps_per_second,peak_rss_mb
+//
+// A cell step is the computation of the next state of one cell at one time step (the runner skips the cells none of
+// whose neighbors changed). The peak RSS is that of the whole process, so every scenario is measured by its own process.
+
+#include <chrono>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <vector>
+#include <sys/resource.h>
+#include "../model/engine/command_line.hpp"
+#include "../model/engine/compiled_scenario.hpp"
+#include "../model/engine/synchronous_runner.hpp"
+
+using TIME = float;
+
+// Counts the states the runner logs instead of formatting them.
+class counting_sink : public log_sink<TIME> {
+public:
+    unsigned long num_states = 0;
+
+    void state(TIME time, cell_index cell, seaird::log_values const &current_state) override {
+        ++num_states;
+    }
+};
+
+int main(int argc, char ** argv) {
+    std::vector<std::string> arguments;
+    unsigned int num_threads = 1;
+    bool header = false;
+    bool valid = true;
+    for(int i = 1; i < argc; ++i) {
+        std::string argument = argv[i];
+        if(argument.rfind("--threads=", 0) == 0) {
+            if(!command_line::parse_num_threads(argument, num_threads)) {
+                std::cerr << command_line::num_threads_error(argument) << std::endl;
+                valid = false;
+            }
+        } else if(argument == "--header") {
+            header = true;
+        } else {
+            arguments.push_back(argument);
+        }
+    }
+    std::optional<float> days;
+    if(arguments.size() == 2) {
+        days = command_line::parse_number<float>(arguments[1]);
+    }
+    if (!valid || !days) {
+        std::cout << "Program used with wrong parameters. The program must be invoked as follows:";
+        std::cout << argv[0] << " SCENARIO DAYS [--threads=N] [--header]" << std::endl;
+        return -1;
+    }
+
+    try {
+        using clock = std::chrono::steady_clock;
+        auto seconds_since = [](clock::time_point start) {
+            return std::chrono::duration<double>(clock::now() - start).count();
+        };
+
+        synchronous_runner<TIME> runner;
+        runner.set_num_threads(num_threads);
+        auto start = clock::now();
+        if(compiled_scenario::is_compiled(arguments[0])) {
+            runner.add_cells_compiled(arguments[0]);
+        } else {
+            runner.add_cells_json(arguments[0]);
+        }
+        double load_seconds = seconds_since(start);
+
+        start = clock::now();
+        runner.couple_cells();
+        double couple_seconds = seconds_since(start);
+
+        counting_sink sink;
+        start = clock::now();
+        runner.run_until(*days, sink);
+        double run_seconds = seconds_since(start);
+
+        unsigned long num_cells = runner.get_cells().size();
+        unsigned long num_edges = 0;
+        for(auto const &cell : runner.get_cells()) {
+            for(auto const &neighbor : cell->neighbors) {
+                num_edges += neighbor != cell->cell_id;
+            }
+        }
+        // The initial state of every cell is logged too.
+        unsigned long cell_steps = sink.num_states - num_cells;
+        rusage usage{};
+        getrusage(RUSAGE_SELF, &usage);
+
+        if(header) {
+            std::cout << "cells,edges,threads,days,load_seconds,couple_seconds,run_seconds,cell_steps,"
+                      << "cell_steps_per_second,peak_rss_mb" << std::endl;
+        }
+        std::cout << num_cells << "," << num_edges << "," << num_threads << "," << runner.get_simulation_time() << ","
+                  << load_seconds << "," << couple_seconds << "," << run_seconds << "," << cell_steps << ","
+                  << cell_steps / run_seconds << "," << usage.ru_maxrss / 1024.0 << std::endl;
+    }
+    catch(std::exception &e) {
+        std::cerr << "A fatal error occurred: " << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,73 @@
+// Builds a scenario from the region and adjacency CSV files of cadmium_gis and an input folder of
+// Scripts/Input_Generator (default.json, fields.json, infectedCell.json), as the generate_*_json.py scripts do (see
+// model/engine/scenario_builder.hpp). The scenario is written as JSON, or compiled with --compiled. An adjacency file
+// without boundary lengths is only accepted with --default-correlation.
+
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "../model/engine/command_line.hpp"
+#include "../model/engine/scenario_builder.hpp"
+
+int main(int argc, char ** argv) {
+    std::vector<std::string> arguments;
+    std::string population_column;
+    bool compiled = false;
+    bool default_correlation = false;
+    unsigned int num_threads = 1;
+    bool valid = true;
+    for(int i = 1; i < argc; ++i) {
+        std::string argument = argv[i];
+        if(argument.rfind("--population-column=", 0) == 0) {
+            population_column = argument.substr(std::string{"--population-column="}.size());
+        } else if(argument == "--compiled") {
+            compiled = true;
+        } else if(argument == "--default-correlation") {
+            default_correlation = true;
+        } else if(argument.rfind("--threads=", 0) == 0) {
+            if(!command_line::parse_num_threads(argument, num_threads)) {
+                std::cerr << command_line::num_threads_error(argument) << std::endl;
+                valid = false;
+            }
+        } else {
+            arguments.push_back(argument);
+        }
+    }
+    if (!valid || arguments.size() != 4) {
+        std::cout << "Program used with wrong parameters. The program must be invoked as follows:";
+        std::cout << argv[0] << " REGIONS.csv ADJACENCY.csv INPUT_DIRECTORY SCENARIO_OUTPUT [--population-column=NAME]"
+                  << " [--compiled] [--default-correlation] [--threads=N]" << std::endl;
+        return -1;
+    }
+
+    try {
+        scenario_builder builder = scenario_builder::from_input_directory(arguments[2]);
+        builder.read_regions(arguments[0], population_column);
+        scenario_builder::stats stats = builder.read_adjacency(arguments[1], default_correlation);
+        if(!stats.boundaries) {
+            std::cout << "No boundary lengths in " << arguments[1] << ": every edge has the default correlation" << std::endl;
+        }
+        std::cout << builder.get_num_cells() << " cells; skipped " << stats.invalid_rows << " adjacency rows of regions"
+                  << " without population and " << stats.zero_correlation_rows << " with a correlation of 0" << std::endl;
+
+        if(compiled) {
+            builder.write_compiled(arguments[3], num_threads);
+        } else {
+            std::ofstream output{arguments[3]};
+            if(!output.is_open()) {
+                throw std::runtime_error{"Unable to open the file: " + arguments[3]};
+            }
+            builder.write_json(output);
+            if(!output) {
+                throw std::runtime_error{"Unable to write " + arguments[3]};
+            }
+        }
+    }
+    catch(std::exception &e) {
+        std::cerr << "A fatal error occurred: " << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
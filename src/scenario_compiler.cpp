@@ -0,0 +1,34 @@
+// Compiles a scenario file into the binary form loaded by pandemic-geographical_model without parsing JSON (see
+// model/engine/compiled_scenario.hpp). The compiled scenario is passed to the simulator instead of the JSON file.
+
+#include <iostream>
+#include <string>
+#include "../model/engine/command_line.hpp"
+#include "../model/engine/compiled_scenario.hpp"
+
+int main(int argc, char ** argv) {
+    if (argc != 3 && argc != 4) {
+        std::cout << "Program used with wrong parameters. The program must be invoked as follows:";
+        std::cout << argv[0] << " SCENARIO_CONFIG.json COMPILED_SCENARIO.bin [--threads=N]" << std::endl;
+        return -1;
+    }
+
+    try {
+        unsigned int num_threads = 1;
+        if(argc == 4) {
+            std::string argument = argv[3];
+            if(argument.rfind("--threads=", 0) != 0) {
+                throw std::invalid_argument{"Unknown option: " + argument};
+            } else if(!command_line::parse_num_threads(argument, num_threads)) {
+                throw std::invalid_argument{command_line::num_threads_error(argument)};
+            }
+        }
+        compiled_scenario::compile(argv[1], argv[2], num_threads);
+    }
+    catch(std::exception &e) {
+        std::cerr << "A fatal error occurred: " << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,78 @@
+// Generates a synthetic scenario of any number of cells (see model/engine/synthetic_scenario.hpp), with the cells of an
+// input folder of Scripts/Input_Generator, and writes it compiled. --csv also writes the regions and the adjacency, from
+// which pandemic-scenario-builder builds the JSON form of the same scenario.
+
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "../model/engine/command_line.hpp"
+#include "../model/engine/synthetic_scenario.hpp"
+
+nlohmann::json read_json(std::string const &file_path) {
+    std::ifstream file{file_path};
+    if(!file.is_open()) {
+        throw std::runtime_error{"Unable to open the file: " + file_path};
+    }
+    nlohmann::json json;
+    file >> json;
+    return json;
+}
+
+int main(int argc, char ** argv) {
+    std::vector<std::string> arguments;
+    std::string input_directory = "../Scripts/Input_Generator/input_ontario_phu";
+    std::string csv_prefix;
+    std::uint64_t seed = 1;
+    unsigned long num_infected = 1;
+    bool valid = true;
+    for(int i = 1; i < argc; ++i) {
+        std::string argument = argv[i];
+        if(argument.rfind("--input=", 0) == 0) {
+            input_directory = argument.substr(std::string{"--input="}.size());
+        } else if(argument.rfind("--seed=", 0) == 0) {
+            valid = valid && command_line::parse_option(argument, seed);
+        } else if(argument.rfind("--infected=", 0) == 0) {
+            valid = valid && command_line::parse_option(argument, num_infected);
+        } else if(argument.rfind("--csv=", 0) == 0) {
+            csv_prefix = argument.substr(std::string{"--csv="}.size());
+        } else {
+            arguments.push_back(argument);
+        }
+    }
+    std::optional<cell_index> num_cells;
+    if(!arguments.empty()) {
+        num_cells = command_line::parse_number<cell_index>(arguments[0]);
+    }
+    if (!valid || !num_cells || arguments.size() != 2) {
+        std::cout << "Program used with wrong parameters. The program must be invoked as follows:";
+        std::cout << argv[0] << " NUM_CELLS SCENARIO_OUTPUT.bin [--input=INPUT_DIRECTORY] [--seed=N] [--infected=N]"
+                  << " [--csv=PREFIX]" << std::endl;
+        return -1;
+    }
+
+    try {
+        synthetic_scenario scenario{*num_cells, seed};
+        std::cout << scenario.get_num_cells() << " cells, " << scenario.get_num_edges() << " edges (mean degree "
+                  << static_cast<double>(scenario.get_num_edges()) / scenario.get_num_cells() << ", max degree "
+                  << scenario.get_max_degree() << ")" << std::endl;
+
+        // infectedCell.json holds an infected cell or an array of them; the state of the first one is used.
+        nlohmann::json infected = read_json(input_directory + "/infectedCell.json");
+        nlohmann::json const &infected_cell = infected.is_array() ? infected.at(0) : infected;
+        scenario.write_compiled(arguments[1], read_json(input_directory + "/default.json").at("default"),
+                                read_json(input_directory + "/fields.json").at("fields").get<std::vector<std::string>>(),
+                                infected_cell.at("state"), num_infected);
+        if(!csv_prefix.empty()) {
+            scenario.write_csv(csv_prefix + "_regions.csv", csv_prefix + "_adjacency.csv");
+        }
+    }
+    catch(std::exception &e) {
+        std::cerr << "A fatal error occurred: " << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
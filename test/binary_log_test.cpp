@@ -0,0 +1,158 @@
+//
+// Writes a run of config/tinyScenario.json to a binary log, converts it back to the text logs and compares them with
+// the text logs of the same run, and replays a delta log of the run against the full log; corrupted and foreign files
+// must be rejected.
+//
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <boost/test/unit_test.hpp>
+#include "../model/engine/binary_log.hpp"
+#include "../model/engine/synchronous_runner.hpp"
+#include "test_files.hpp"
+
+using TIME = float;
+
+namespace {
+    constexpr TIME days = 50;
+    constexpr double delta_epsilon = 1e-4;
+
+    std::string const scenario_path = source_path("config/tinyScenario.json");
+
+    // Runs the scenario once into the text logs and into the binary log at log_path.
+    void run_scenario(std::string const &log_path, std::ostringstream &messages, std::ostringstream &states) {
+        synchronous_runner<TIME> runner;
+        runner.add_cells_json(scenario_path);
+        runner.couple_cells();
+
+        text_log_sink<TIME> text_sink{messages, states};
+        binary_log::writer<TIME> binary_sink{log_path};
+        log_sink_group<TIME> sinks;
+        sinks.add(text_sink);
+        sinks.add(binary_sink);
+        runner.run_until(days, sinks);
+    }
+
+    // The values of every cell at every time step of a log, as replayed from it.
+    struct replayed_step {
+        double time;
+        std::vector<seaird::log_values> values;
+        std::vector<char> known;
+    };
+
+    std::vector<replayed_step> replay(std::string const &log_path) {
+        binary_log::reader log{log_path};
+        std::vector<replayed_step> steps;
+        binary_log::replay(log, [&steps](double time, std::vector<seaird::log_values> const &values,
+                                         std::vector<char> const &known) {
+            steps.push_back({time, values, known});
+        });
+        return steps;
+    }
+
+    // Reads a whole binary log as the log converter does.
+    void convert_to_text(std::string const &log_path) {
+        binary_log::reader log{log_path};
+        std::ostringstream messages;
+        std::ostringstream states;
+        binary_log::convert_to_text<TIME>(log, messages, states);
+    }
+}
+
+BOOST_AUTO_TEST_SUITE(binary_logs)
+
+BOOST_AUTO_TEST_CASE(binary_log_converts_back_to_the_text_logs) {
+    std::string const log_path = output_path("tinyScenario_log.bin");
+    std::ostringstream messages;
+    std::ostringstream states;
+    run_scenario(log_path, messages, states);
+
+    binary_log::reader log{log_path};
+    BOOST_TEST(!log.is_delta());
+    std::ostringstream converted_messages;
+    std::ostringstream converted_states;
+    binary_log::convert_to_text<TIME>(log, converted_messages, converted_states);
+    BOOST_TEST(converted_messages.str() == messages.str());
+    BOOST_TEST(converted_states.str() == states.str());
+}
+
+BOOST_AUTO_TEST_CASE(delta_log_replays_the_full_log_within_its_epsilon) {
+    synchronous_runner<TIME> runner;
+    runner.add_cells_json(scenario_path);
+    runner.couple_cells();
+
+    std::string const full_path = output_path("tinyScenario_full_log.bin");
+    std::string const delta_path = output_path("tinyScenario_delta_log.bin");
+    binary_log::writer<TIME> full_sink{full_path};
+    binary_log::writer<TIME> delta_sink{delta_path, delta_epsilon};
+    log_sink_group<TIME> sinks;
+    sinks.add(full_sink);
+    sinks.add(delta_sink);
+    runner.run_until(days, sinks);
+
+    std::vector<replayed_step> const full = replay(full_path);
+    std::vector<replayed_step> const delta = replay(delta_path);
+    BOOST_TEST(delta.size() == full.size());
+    // A delta log keeps the last state written for a cell until a value moves by more than the epsilon from it (see
+    // binary_log::writer::changed), so every replayed value is within the epsilon of the full log.
+    for(std::size_t step = 0; step < std::min(delta.size(), full.size()); ++step) {
+        BOOST_TEST(delta[step].time == full[step].time);
+        BOOST_TEST(delta[step].known == full[step].known);
+        for(std::size_t cell = 0; cell < full[step].values.size(); ++cell) {
+            for(std::size_t field = 0; field < seaird::num_log_fields; ++field) {
+                double const expected = full[step].values[cell][field];
+                double const value = delta[step].values[cell][field];
+                BOOST_TEST(std::abs(value - expected) <= delta_epsilon * std::max(1.0, std::abs(value)),
+                           "step " << step << ", cell " << cell << ", field " << field << ": " << value << " != "
+                                   << expected);
+            }
+        }
+    }
+    BOOST_TEST(read_file(delta_path).size() < read_file(full_path).size());
+
+    // A delta log has no messages to convert to the text logs.
+    BOOST_CHECK_THROW(convert_to_text(delta_path), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(corrupted_and_foreign_binary_logs_are_rejected) {
+    std::string const log_path = output_path("tinyScenario_log.bin");
+    std::ostringstream messages;
+    std::ostringstream states;
+    run_scenario(log_path, messages, states);
+    std::string const log = read_file(log_path);
+
+    std::string const corrupted_path = output_path("tinyScenario_corrupted_log.bin");
+    // A text log is not a binary log.
+    BOOST_CHECK_THROW(binary_log::reader{source_path("test/golden/tinyScenario_messages.txt")}, std::runtime_error);
+
+    // Another version (after the magic).
+    std::string other_version = log;
+    std::uint32_t const version = binary_log::version + 1;
+    std::memcpy(&other_version[sizeof(binary_log::magic)], &version, sizeof(version));
+    write_file(corrupted_path, other_version);
+    BOOST_CHECK_THROW(binary_log::reader{corrupted_path}, std::runtime_error);
+
+    // A log cut in the middle of its last record.
+    write_file(corrupted_path, log.substr(0, log.size() - sizeof(binary_log::record) / 2));
+    BOOST_CHECK_THROW(convert_to_text(corrupted_path), std::runtime_error);
+
+    // A record of a cell that is not in the table of the cell IDs: the last record is the state of a cell.
+    std::string unknown_cell = log;
+    std::uint32_t const cell = 1000;
+    std::memcpy(&unknown_cell[log.size() - sizeof(binary_log::record) + offsetof(binary_log::record, cell)], &cell,
+                sizeof(cell));
+    write_file(corrupted_path, unknown_cell);
+    BOOST_CHECK_THROW(convert_to_text(corrupted_path), std::runtime_error);
+
+    // The log itself is fine.
+    BOOST_CHECK_NO_THROW(convert_to_text(log_path));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
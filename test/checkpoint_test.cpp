@@ -0,0 +1,119 @@
+//
+// Runs config/tinyScenario.json with checkpoints, resumes it from one of them and compares the logs of the resumed run
+// with those of the uninterrupted run; corrupted and foreign checkpoints must be rejected.
+//
+
+#include <cstdint>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <boost/test/unit_test.hpp>
+#include "../model/engine/checkpoint.hpp"
+#include "../model/engine/synchronous_runner.hpp"
+#include "test_files.hpp"
+
+using TIME = float;
+
+namespace {
+    constexpr TIME days = 50;
+    constexpr TIME checkpoint_interval = 10;
+    constexpr TIME resume_time = 20;
+
+    std::string const scenario_path = source_path("config/tinyScenario.json");
+    std::string const checkpoint_prefix = output_path("tinyScenario_checkpoint");
+
+    // The part of a text log from the time step of the given time on.
+    std::string log_from(std::string const &log, TIME time) {
+        std::ostringstream time_line;
+        text_log_sink<TIME>::write_time(time_line, time);
+        std::size_t start = log.find("\n" + time_line.str());
+        return start == std::string::npos ? "" : log.substr(start + 1);
+    }
+
+    // Resumes the scenario from a checkpoint and runs it until the end.
+    void resume(std::string const &checkpoint_path, std::ostringstream &messages, std::ostringstream &states) {
+        synchronous_runner<TIME> runner;
+        runner.add_cells_json(scenario_path);
+        runner.couple_cells();
+        runner.resume_from_checkpoint(checkpoint_path);
+        text_log_sink<TIME> sink{messages, states};
+        runner.run_until(days, sink);
+    }
+
+    void resume(std::string const &checkpoint_path) {
+        std::ostringstream messages;
+        std::ostringstream states;
+        resume(checkpoint_path, messages, states);
+    }
+
+    // Runs the whole scenario, writing its checkpoints; returns the path of the checkpoint of resume_time.
+    std::string run_with_checkpoints(std::ostringstream &messages, std::ostringstream &states) {
+        synchronous_runner<TIME> runner;
+        runner.add_cells_json(scenario_path);
+        runner.couple_cells();
+        runner.set_checkpoints(checkpoint_interval, checkpoint_prefix);
+        text_log_sink<TIME> sink{messages, states};
+        runner.run_until(days, sink);
+        return checkpoint::file_name(checkpoint_prefix, resume_time);
+    }
+}
+
+BOOST_AUTO_TEST_SUITE(checkpoints)
+
+BOOST_AUTO_TEST_CASE(resumed_run_logs_what_the_uninterrupted_run_logs) {
+    std::ostringstream messages;
+    std::ostringstream states;
+    std::string const checkpoint_path = run_with_checkpoints(messages, states);
+
+    std::ostringstream resumed_messages;
+    std::ostringstream resumed_states;
+    resume(checkpoint_path, resumed_messages, resumed_states);
+    BOOST_TEST(!resumed_messages.str().empty());
+    BOOST_TEST(resumed_messages.str() == log_from(messages.str(), resume_time));
+    BOOST_TEST(resumed_states.str() == log_from(states.str(), resume_time));
+}
+
+BOOST_AUTO_TEST_CASE(corrupted_and_foreign_checkpoints_are_rejected) {
+    std::ostringstream messages;
+    std::ostringstream states;
+    std::string const checkpoint_path = run_with_checkpoints(messages, states);
+    std::string const saved = read_file(checkpoint_path);
+    std::string const corrupted_path = output_path("tinyScenario_corrupted_checkpoint.bin");
+
+    // A scenario file is not a checkpoint.
+    BOOST_CHECK_THROW(resume(scenario_path), std::runtime_error);
+
+    // Another version (after the magic).
+    std::string other_version = saved;
+    std::uint32_t const version = checkpoint::version + 1;
+    std::memcpy(&other_version[sizeof(checkpoint::magic)], &version, sizeof(version));
+    write_file(corrupted_path, other_version);
+    BOOST_CHECK_THROW(resume(corrupted_path), std::runtime_error);
+
+    // A checkpoint of other cells: the hash of the cell IDs follows the time.
+    std::string other_cells = saved;
+    other_cells[sizeof(checkpoint::magic) + 2 * sizeof(std::uint32_t) + sizeof(double)] ^= 1;
+    write_file(corrupted_path, other_cells);
+    BOOST_CHECK_THROW(resume(corrupted_path), std::invalid_argument);
+
+    // A truncated checkpoint.
+    write_file(corrupted_path, saved.substr(0, saved.size() / 2));
+    BOOST_CHECK_THROW(resume(corrupted_path), std::runtime_error);
+
+    // A count of age group proportions of the first cell larger than the file. After the header (the magic, the
+    // version, the byte order mark, the time, the hash and the number of cells) come the published flag of the cell,
+    // the numbers of age groups and phases of its state and five doubles.
+    std::string huge_count = saved;
+    std::size_t const offset = sizeof(checkpoint::magic) + 2 * sizeof(std::uint32_t) + sizeof(double) +
+                               sizeof(std::uint64_t) + sizeof(std::uint32_t) + 1 + 5 * sizeof(std::uint32_t) +
+                               5 * sizeof(double);
+    std::uint32_t const count = 0xfffffff0;
+    std::memcpy(&huge_count[offset], &count, sizeof(count));
+    write_file(corrupted_path, huge_count);
+    BOOST_CHECK_THROW(resume(corrupted_path), std::runtime_error);
+
+    BOOST_CHECK_NO_THROW(resume(checkpoint_path));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
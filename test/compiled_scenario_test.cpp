@@ -0,0 +1,139 @@
+//
+// Compiles config/tinyScenario.json and compares what compiled_scenario::read gives back with what scenario_loader
+// loads from the JSON file; corrupted and foreign files must be rejected.
+//
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include <boost/test/unit_test.hpp>
+#include "../model/engine/compiled_scenario.hpp"
+#include "../model/engine/scenario_loader.hpp"
+#include "../model/engine/thread_pool.hpp"
+#include "test_files.hpp"
+
+namespace {
+    std::string const scenario_path = source_path("config/tinyScenario.json");
+
+    void check_same_config(simulation_config const &expected, simulation_config const &config) {
+        BOOST_TEST(config.prec_divider == expected.prec_divider);
+        BOOST_TEST(config.virulence_rates == expected.virulence_rates);
+        BOOST_TEST(config.incubation_rates == expected.incubation_rates);
+        BOOST_TEST(config.recovery_rates == expected.recovery_rates);
+        BOOST_TEST(config.mobility_rates == expected.mobility_rates);
+        BOOST_TEST(config.fatality_rates == expected.fatality_rates);
+        BOOST_TEST(config.asymptomatic_rates == expected.asymptomatic_rates);
+        BOOST_TEST(config.SIIRS_model == expected.SIIRS_model);
+    }
+
+    // seaird::operator!= leaves out the fatalities and what does not change while a scenario runs.
+    void check_same_state(seaird const &expected, seaird const &state) {
+        BOOST_TEST(!(state != expected));
+        BOOST_TEST(state.log_fields() == expected.log_fields());
+        auto fatalities = [](seaird const &of) {
+            return std::vector<double>(of.fatalities().begin(), of.fatalities().end());
+        };
+        BOOST_TEST(fatalities(state) == fatalities(expected));
+        BOOST_TEST(*state.age_group_proportions == *expected.age_group_proportions);
+        BOOST_TEST(*state.disobedient == *expected.disobedient);
+        BOOST_TEST(state.hospital_capacity == expected.hospital_capacity);
+        BOOST_TEST(state.fatality_modifier == expected.fatality_modifier);
+    }
+
+    void check_same_cell(cell_definition const &expected, cell_definition const &cell) {
+        BOOST_TEST_CONTEXT("cell " << expected.cell_id) {
+            BOOST_TEST(cell.cell_id == expected.cell_id);
+            BOOST_TEST(cell.cell_type == expected.cell_type);
+            BOOST_TEST(cell.delay_id == expected.delay_id);
+            check_same_config(*expected.config, *cell.config);
+            check_same_state(expected.initial_state, cell.initial_state);
+            BOOST_TEST(cell.neighborhood.size() == expected.neighborhood.size());
+            for(auto const &edge : expected.neighborhood) {
+                auto compiled_edge = cell.neighborhood.find(edge.first);
+                BOOST_TEST_REQUIRE((compiled_edge != cell.neighborhood.end()), "neighbor " << edge.first);
+                BOOST_TEST(compiled_edge->second.correlation == edge.second.correlation);
+                BOOST_TEST(compiled_edge->second.get_correction_factors() == edge.second.get_correction_factors());
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_SUITE(compiled_scenarios)
+
+BOOST_AUTO_TEST_CASE(compiled_scenario_reads_what_the_loader_loads) {
+    std::string const compiled_path = output_path("tinyScenario.bin");
+    compiled_scenario::compile(scenario_path, compiled_path);
+    BOOST_TEST(compiled_scenario::is_compiled(compiled_path));
+    BOOST_TEST(compiled_scenario::read_source_hash(compiled_path) == compiled_scenario::content_hash(scenario_path));
+
+    thread_pool pool{1};
+    std::vector<cell_definition> const expected = scenario_loader::load(scenario_path, pool);
+    compiled_scenario::scenario const compiled = compiled_scenario::read(compiled_path);
+    BOOST_TEST(compiled.fields == scenario_loader::read_fields(scenario_path));
+    BOOST_TEST(compiled.cell_order == scenario_loader::read_cell_order(scenario_path));
+    BOOST_TEST_REQUIRE(compiled.cells.size() == expected.size());
+    for(std::size_t i = 0; i < expected.size(); ++i) {
+        check_same_cell(expected[i], compiled.cells[i]);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(corrupted_and_foreign_compiled_scenarios_are_rejected) {
+    std::string const compiled_path = output_path("tinyScenario.bin");
+    compiled_scenario::compile(scenario_path, compiled_path);
+    std::string const compiled = read_file(compiled_path);
+    std::string const corrupted_path = output_path("tinyScenario_corrupted.bin");
+
+    // A scenario file is not a compiled scenario.
+    BOOST_TEST(!compiled_scenario::is_compiled(scenario_path));
+    BOOST_CHECK_THROW(compiled_scenario::read(scenario_path), std::runtime_error);
+
+    // Another version (after the magic).
+    std::string other_version = compiled;
+    std::uint32_t const version = compiled_scenario::version + 1;
+    std::memcpy(&other_version[sizeof(compiled_scenario::magic)], &version, sizeof(version));
+    write_file(corrupted_path, other_version);
+    BOOST_CHECK_THROW(compiled_scenario::read(corrupted_path), std::runtime_error);
+
+    // A truncated file.
+    write_file(corrupted_path, compiled.substr(0, compiled.size() / 2));
+    BOOST_CHECK_THROW(compiled_scenario::read(corrupted_path), std::runtime_error);
+
+    // A count of fields larger than the file (the first count after the header: the magic, the version, the byte order
+    // mark and the hash), which must be refused before anything is allocated for it.
+    std::string huge_count = compiled;
+    std::uint32_t const count = 0xfffffff0;
+    std::memcpy(&huge_count[sizeof(compiled_scenario::magic) + 2 * sizeof(std::uint32_t) + sizeof(std::uint64_t)],
+                &count, sizeof(count));
+    write_file(corrupted_path, huge_count);
+    BOOST_CHECK_THROW(compiled_scenario::read(corrupted_path), std::runtime_error);
+
+    // An index out of its table: the last edge of the last cell refers to its profile last.
+    std::string bad_index = compiled;
+    std::uint32_t const index = 1000;
+    std::memcpy(&bad_index[compiled.size() - sizeof(index)], &index, sizeof(index));
+    write_file(corrupted_path, bad_index);
+    BOOST_CHECK_THROW(compiled_scenario::read(corrupted_path), std::runtime_error);
+
+    BOOST_CHECK_NO_THROW(compiled_scenario::read(compiled_path));
+}
+
+BOOST_AUTO_TEST_CASE(scenario_cache_creates_its_directory) {
+    // The directories are removed first, as a previous run of the tests left them.
+    std::string const cache_parent = output_path("scenario_cache");
+    std::string const cache_directory = cache_parent + "/tiny";
+    std::remove(compiled_scenario::load_cached(scenario_path, cache_directory).c_str());
+    ::rmdir(cache_directory.c_str());
+    ::rmdir(cache_parent.c_str());
+
+    std::string const cached_path = compiled_scenario::load_cached(scenario_path, cache_directory);
+    BOOST_TEST(cached_path.rfind(cache_directory + "/", 0) == 0);
+    BOOST_TEST(compiled_scenario::read_source_hash(cached_path) == compiled_scenario::content_hash(scenario_path));
+    // The second time, the compiled file of the cache is used.
+    BOOST_TEST(compiled_scenario::load_cached(scenario_path, cache_directory) == cached_path);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,80 @@
+//
+// Runs config/tinyScenario.json with Cadmium's runner and with the synchronous runner, and compares the message and
+// state logs of both with the golden logs of test/golden.
+//
+
+#include <memory>
+#include <sstream>
+#include <boost/test/unit_test.hpp>
+#include <cadmium/modeling/dynamic_coupled.hpp>
+#include <cadmium/engine/pdevs_dynamic_runner.hpp>
+#include <cadmium/logger/common_loggers.hpp>
+#include "../model/geographical_coupled.hpp"
+#include "../model/engine/synchronous_runner.hpp"
+#include "test_files.hpp"
+
+using TIME = float;
+
+namespace {
+    // The golden logs are those of `./pandemic-geographical_model ../config/tinyScenario.json 50`. A change of the
+    // model that changes its results must update them.
+    constexpr TIME golden_days = 50;
+
+    std::string const scenario_path = source_path("config/tinyScenario.json");
+    std::string const golden_messages_path = source_path("test/golden/tinyScenario_messages.txt");
+    std::string const golden_state_path = source_path("test/golden/tinyScenario_state.txt");
+
+    // The loggers of main.cpp, writing to strings.
+    std::ostringstream cadmium_messages;
+    std::ostringstream cadmium_state;
+
+    struct oss_sink_messages {
+        static std::ostream &sink() {
+            return cadmium_messages;
+        }
+    };
+
+    struct oss_sink_state {
+        static std::ostream &sink() {
+            return cadmium_state;
+        }
+    };
+
+    using namespace cadmium;
+    using state = logger::logger<logger::logger_state, dynamic::logger::formatter<TIME>, oss_sink_state>;
+    using log_messages = logger::logger<logger::logger_messages, dynamic::logger::formatter<TIME>, oss_sink_messages>;
+    using global_time_mes =
+            logger::logger<logger::logger_global_time, dynamic::logger::formatter<TIME>, oss_sink_messages>;
+    using global_time_sta =
+            logger::logger<logger::logger_global_time, dynamic::logger::formatter<TIME>, oss_sink_state>;
+    using logger_top = logger::multilogger<state, log_messages, global_time_mes, global_time_sta>;
+}
+
+BOOST_AUTO_TEST_SUITE(engines)
+
+BOOST_AUTO_TEST_CASE(cadmium_logs_the_golden_logs) {
+    auto top_model = std::make_shared<geographical_coupled<TIME>>("");
+    top_model->add_cells_json(scenario_path);
+    top_model->couple_cells();
+    std::shared_ptr<dynamic::modeling::coupled<TIME>> t = top_model;
+
+    dynamic::engine::runner<TIME, logger_top> r(t, {0});
+    r.run_until(golden_days);
+    check_same_steps(read_file(golden_messages_path), cadmium_messages.str());
+    check_same_steps(read_file(golden_state_path), cadmium_state.str());
+}
+
+BOOST_AUTO_TEST_CASE(synchronous_runner_logs_the_golden_logs) {
+    synchronous_runner<TIME> runner;
+    runner.add_cells_json(scenario_path);
+    runner.couple_cells();
+
+    std::ostringstream messages;
+    std::ostringstream states;
+    text_log_sink<TIME> sink{messages, states};
+    runner.run_until(golden_days, sink);
+    check_same_steps(read_file(golden_messages_path), messages.str());
+    check_same_steps(read_file(golden_state_path), states.str());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
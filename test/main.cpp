@@ -0,0 +1,7 @@
+//
+// The module of the tests of the model (see CMakeLists.txt). Boost.Test is compiled in here, so the tests do not
+// depend on how the Boost libraries of the system were built.
+//
+
+#define BOOST_TEST_MODULE pandemic-tests
+#include <boost/test/included/unit_test.hpp>
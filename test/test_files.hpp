@@ -0,0 +1,91 @@
+//
+// Files of the tests: the paths of the repository and of the outputs, and the comparison of text logs.
+//
+
+#ifndef PANDEMIC_HOYA_2002_TEST_FILES_HPP
+#define PANDEMIC_HOYA_2002_TEST_FILES_HPP
+
+#include <algorithm>
+#include <fstream>
+#include <istream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <boost/test/unit_test.hpp>
+
+// PANDEMIC_SOURCE_DIR and PANDEMIC_TEST_OUTPUT_DIR are set by CMakeLists.txt.
+inline std::string source_path(std::string const &relative_path) {
+    return std::string{PANDEMIC_SOURCE_DIR} + "/" + relative_path;
+}
+
+inline std::string output_path(std::string const &file_name) {
+    return std::string{PANDEMIC_TEST_OUTPUT_DIR} + "/" + file_name;
+}
+
+inline std::string read_file(std::string const &file_path) {
+    std::ifstream file{file_path, std::ios::binary};
+    if(!file.is_open()) {
+        throw std::runtime_error{"Unable to open the file: " + file_path};
+    }
+    std::ostringstream contents;
+    contents << file.rdbuf();
+    return contents.str();
+}
+
+inline void write_file(std::string const &file_path, std::string const &contents) {
+    std::ofstream file{file_path, std::ios::binary};
+    file << contents;
+    if(!file) {
+        throw std::runtime_error{"Unable to write " + file_path};
+    }
+}
+
+// A time step of a message or state log: its time line and the lines logged at that time, sorted. Cadmium's runner and
+// the synchronous runner log the cells of a step in different orders (see synchronous_runner.hpp), so logs are
+// compared step by step, regardless of the order of the lines within a step.
+struct log_step {
+    std::string time;
+    std::vector<std::string> lines;
+
+    bool operator==(log_step const &other) const {
+        return time == other.time && lines == other.lines;
+    }
+};
+
+inline std::vector<log_step> read_steps(std::string const &log) {
+    std::vector<log_step> steps;
+    std::istringstream lines{log};
+    std::string line;
+    while(std::getline(lines, line)) {
+        // The messages start with the port ("[...") and the states with "State for model"; anything else is a time.
+        if(line.rfind("[", 0) == 0 || line.rfind("State for model", 0) == 0) {
+            if(steps.empty()) {
+                throw std::runtime_error{"Log line before the first time: " + line};
+            }
+            steps.back().lines.push_back(line);
+        } else {
+            steps.push_back({line, {}});
+        }
+    }
+    for(auto &step : steps) {
+        std::sort(step.lines.begin(), step.lines.end());
+    }
+    return steps;
+}
+
+// Checks that two text logs have the same lines at every time step, and reports the first step that differs.
+inline void check_same_steps(std::string const &expected_log, std::string const &log) {
+    std::vector<log_step> expected = read_steps(expected_log);
+    std::vector<log_step> steps = read_steps(log);
+    BOOST_TEST(steps.size() == expected.size());
+    for(std::size_t i = 0; i < std::min(steps.size(), expected.size()); ++i) {
+        if(!(steps[i] == expected[i])) {
+            BOOST_ERROR("Step " << i << " (time " << steps[i].time << ") differs from the expected step (time "
+                                << expected[i].time << ")");
+            return;
+        }
+    }
+}
+
+#endif //PANDEMIC_HOYA_2002_TEST_FILES_HPP